@@ -0,0 +1,58 @@
+#ifndef LIBSYSCALL_BENCH_COMMON_H
+#define LIBSYSCALL_BENCH_COMMON_H
+
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+
+// timestamps are in cycles where a cycle counter is available, otherwise in nanoseconds
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define LIBSYSCALL_BENCH_UNIT "cycles"
+static inline uint64_t bench_now(void) {
+	_mm_lfence();
+	uint64_t t = __rdtsc();
+	_mm_lfence();
+	return t;
+}
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define LIBSYSCALL_BENCH_UNIT "cycles"
+static inline uint64_t bench_now(void) {
+	_mm_lfence();
+	uint64_t t = __rdtsc();
+	_mm_lfence();
+	return t;
+}
+#else
+#define LIBSYSCALL_BENCH_UNIT "ns"
+static inline uint64_t bench_now(void) {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+// stops the compiler from optimizing away a value
+template <typename T>
+static inline void bench_keep(T const& value) {
+#if defined(_MSC_VER)
+	static volatile const void* sink;
+	sink = &value;
+#else
+	asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+// a tiny xorshift generator, used to build access orders that defeat the hardware prefetcher
+struct bench_random {
+	uint64_t state;
+	inline bench_random(uint64_t seed) : state(seed == 0 ? 0x9E3779B97F4A7C15ull : seed) {}
+	inline uint64_t next(void) {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+};
+
+#endif // LIBSYSCALL_BENCH_COMMON_H
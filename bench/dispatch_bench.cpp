@@ -0,0 +1,201 @@
+// measures the cost of dispatching a syscall, and how it scales across threads
+//
+// 'call<S>' and 'try_call<S>' are compared against a direct call, a virtual call and a real kernel syscall ('getppid'),
+//  then 1 to N threads call on a single shared fd, on an fd of their own, and on their own fds while another thread opens and closes fds
+//
+// results are written to stdout as JSON, so they can be collected for regression tracking
+//
+// usage: libsyscall_dispatch_bench [max threads, default std::thread::hardware_concurrency()]
+
+#include <libsyscall/libsyscall.h>
+#include "bench_common.h"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#endif
+
+#if defined(_MSC_VER)
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+struct SYS_BENCH : Syscall<SYS_BENCH, int(int)> {};
+
+struct BENCH_SYSCALLS : SYSCALLS<SYS_BENCH> {};
+
+BENCH_NOINLINE static int bench_syscall(int fd, void*, int value) {
+	bench_keep(fd);
+	return fd + value;
+}
+
+BENCH_NOINLINE static int bench_direct(int fd, int value) {
+	bench_keep(fd);
+	return fd + value;
+}
+
+struct bench_base {
+	virtual ~bench_base() {}
+	virtual int call(int fd, int value) = 0;
+};
+
+struct bench_derived : bench_base {
+	int call(int fd, int value) override {
+		bench_keep(fd);
+		return fd + value;
+	}
+};
+
+static inline long bench_kernel() {
+#if defined(_WIN32)
+	// there is no cheap documented syscall on windows, this is a kernel32 call that stays in userspace
+	return (long)GetCurrentProcessId();
+#elif defined(__linux__)
+	// the raw syscall, so that no libc can answer from a cache
+	return syscall(SYS_getppid);
+#else
+	return (long)getppid();
+#endif
+}
+
+template <typename F>
+static double per_call(size_t count, F call) {
+	uint64_t start = bench_now();
+	for (size_t i = 0; i < count; i++) {
+		bench_keep(call((int)i));
+	}
+	return (double)(bench_now() - start) / (double)count;
+}
+
+template <typename F>
+static double best_of(F run) {
+	// report the best of several runs, to filter out scheduling noise
+	const int repeats = 7;
+	double best = run();
+	for (int k = 0; k < repeats; k++) {
+		double t = run();
+		if (t < best) best = t;
+	}
+	return best;
+}
+
+enum bench_mode {
+	// every thread calls on the same fd
+	BENCH_SAME_FD,
+	// every thread calls on an fd of its own
+	BENCH_DISTINCT_FDS,
+	// like BENCH_DISTINCT_FDS, while one more thread keeps opening and closing fds
+	BENCH_CHURN,
+};
+
+struct bench_scaling_result {
+	// the average over the calling threads
+	double call;
+	// cycles per open and close pair of the churning thread, 0 unless BENCH_CHURN
+	double churn;
+};
+
+static bench_scaling_result run_threads(BENCH_SYSCALLS & sys, SYSCALL_BASE::SyscallProvider & provider, size_t threads, bench_mode mode, size_t calls) {
+	std::vector<int> fds(threads);
+	for (size_t t = 0; t < threads; t++) {
+		fds[t] = mode == BENCH_SAME_FD && t != 0 ? fds[0] : sys.allocate_fd(provider, nullptr, nullptr);
+	}
+	std::atomic<size_t> arrived = { 0 };
+	std::atomic<size_t> finished = { 0 };
+	std::vector<double> results(threads);
+	size_t participants = threads + (mode == BENCH_CHURN ? 1 : 0);
+
+	std::vector<std::thread> workers;
+	for (size_t t = 0; t < threads; t++) {
+		workers.emplace_back([&, t] {
+			int fd = fds[t];
+			arrived.fetch_add(1);
+			while (arrived.load() != participants) std::this_thread::yield();
+			results[t] = per_call(calls, [&](int i) { return sys.call<SYS_BENCH>(fd, i); });
+			finished.fetch_add(1);
+		});
+	}
+	double churn = 0;
+	if (mode == BENCH_CHURN) {
+		arrived.fetch_add(1);
+		while (arrived.load() != participants) std::this_thread::yield();
+		uint64_t pairs = 0;
+		uint64_t start = bench_now();
+		while (finished.load(std::memory_order_relaxed) != threads) {
+			int fd = sys.allocate_fd(provider, nullptr, nullptr);
+			sys.deallocate_fd(provider, fd);
+			pairs++;
+		}
+		churn = pairs == 0 ? 0 : (double)(bench_now() - start) / (double)pairs;
+	}
+	for (std::thread & w : workers) w.join();
+
+	for (size_t t = 0; t < threads; t++) {
+		if (mode != BENCH_SAME_FD || t == 0) sys.deallocate_fd(provider, fds[t]);
+	}
+	double total = 0;
+	for (double r : results) total += r;
+	return { total / (double)threads, churn };
+}
+
+int main(int argc, char** argv) {
+	const size_t calls = 1 << 20;
+	const size_t kernel_calls = 1 << 16;
+	const size_t thread_calls = 1 << 18;
+
+	size_t max_threads = argc > 1 ? (size_t)strtoul(argv[1], nullptr, 10) : (size_t)std::thread::hardware_concurrency();
+	if (max_threads == 0) max_threads = 1;
+
+	BENCH_SYSCALLS sys;
+	SYSCALL_BASE::SyscallProvider & provider = sys.create_provider_entry();
+	sys.register_syscall<SYS_BENCH>(provider, &bench_syscall);
+	int fd = sys.allocate_fd(provider, nullptr, nullptr);
+
+	bench_derived derived;
+	bench_base * volatile object = &derived;
+
+	double direct = best_of([&] { return per_call(calls, [&](int i) { return bench_direct(fd, i); }); });
+	double virtual_call = best_of([&] { bench_base * o = object; return per_call(calls, [&](int i) { return o->call(fd, i); }); });
+	double kernel = best_of([&] { return per_call(kernel_calls, [&](int) { return bench_kernel(); }); });
+	double call = best_of([&] { return per_call(calls, [&](int i) { return sys.call<SYS_BENCH>(fd, i); }); });
+	double try_call = best_of([&] { return per_call(calls, [&](int i) { return sys.try_call<SYS_BENCH>(fd, i).value_or(0); }); });
+
+	printf("{\n");
+	printf("  \"unit\": \"%s\",\n", LIBSYSCALL_BENCH_UNIT);
+	printf("  \"single_thread\": {\n");
+	printf("    \"direct\": %.2f,\n", direct);
+	printf("    \"virtual\": %.2f,\n", virtual_call);
+	printf("    \"kernel_getppid\": %.2f,\n", kernel);
+	printf("    \"call\": %.2f,\n", call);
+	printf("    \"try_call\": %.2f\n", try_call);
+	printf("  },\n");
+	printf("  \"scaling\": [");
+
+	std::vector<size_t> counts;
+	for (size_t t = 1; t < max_threads; t *= 2) counts.push_back(t);
+	counts.push_back(max_threads);
+	for (size_t i = 0; i < counts.size(); i++) {
+		size_t threads = counts[i];
+		bench_scaling_result same = run_threads(sys, provider, threads, BENCH_SAME_FD, thread_calls);
+		bench_scaling_result distinct = run_threads(sys, provider, threads, BENCH_DISTINCT_FDS, thread_calls);
+		bench_scaling_result churn = run_threads(sys, provider, threads, BENCH_CHURN, thread_calls);
+		printf("%s\n    { \"threads\": %zu, \"same_fd\": %.2f, \"distinct_fds\": %.2f, \"churn_call\": %.2f, \"churn_open_close\": %.2f }",
+			i == 0 ? "" : ",", threads, same.call, distinct.call, churn.call, churn.churn);
+		fflush(stdout);
+	}
+	printf("\n  ]\n}\n");
+
+	sys.deallocate_fd(provider, fd);
+	return 0;
+}
@@ -0,0 +1,55 @@
+// measures the cost of a non-blocking poll 'wait' as a function of watched and ready fd's
+//
+// delivery walks only the ready list, so the cost should follow the number of ready fd's and not the number of watched ones
+
+#include <libsyscall/syscall_poll.h>
+#include "bench_common.h"
+
+#include <vector>
+#include <cstdio>
+
+struct SYS_NOP : Syscall<SYS_NOP, void()> {};
+
+struct BENCH_SYSCALLS : SYSCALLS<SYS_NOP> {};
+
+int main() {
+	size_t watched_counts[] = { 1000, 10000, 100000 };
+	size_t ready_counts[] = { 1, 16, 256 };
+	const size_t rounds = 2000;
+
+	printf("%-10s %-10s %18s\n", "watched", "ready", "wait (" LIBSYSCALL_BENCH_UNIT ")");
+
+	for (size_t watched : watched_counts) {
+		BENCH_SYSCALLS sys;
+		SyscallPoll poll(sys);
+		SYSCALL_BASE::SyscallProvider & provider = sys.create_provider_entry();
+		int poll_fd = poll.create();
+		std::vector<int> fds(watched);
+		for (size_t i = 0; i < watched; i++) {
+			fds[i] = sys.allocate_fd(provider, nullptr, nullptr);
+			poll.control(poll_fd, SYSCALL_POLL_CTL_ADD, fds[i], SYSCALL_POLL_IN | SYSCALL_POLL_ET, i);
+		}
+		std::vector<SyscallPollEvent> events(256);
+		bench_random rng(watched);
+
+		for (size_t ready : ready_counts) {
+			uint64_t total = 0;
+			for (size_t r = 0; r < rounds; r++) {
+				for (size_t k = 0; k < ready; k++) {
+					int fd = fds[rng.next() % watched];
+					poll.lower(fd, SYSCALL_POLL_IN);
+					poll.raise(fd, SYSCALL_POLL_IN);
+				}
+				uint64_t start = bench_now();
+				bench_keep(poll.wait(poll_fd, events.data(), (int)events.size(), 0));
+				total += bench_now() - start;
+			}
+			printf("%-10zu %-10zu %18.2f\n", watched, ready, (double)total / (double)rounds);
+		}
+
+		for (int fd : fds) {
+			sys.deallocate_fd(provider, fd);
+		}
+	}
+	return 0;
+}
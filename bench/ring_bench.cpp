@@ -0,0 +1,109 @@
+// compares the per-call cost of plain 'call<S>' against batched execution through a SyscallRing
+//
+// fds are spread over several providers and visited in random order,
+//  so both the per-call lock and the slot lookups are part of the measured cost
+
+#include <libsyscall/syscall_ring.h>
+#include "bench_common.h"
+
+#include <vector>
+#include <cstdio>
+
+#if defined(_MSC_VER)
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+struct SYS_BENCH : Syscall<SYS_BENCH, int(int)> {};
+struct SYS_OTHER : Syscall<SYS_OTHER, void()> {};
+
+struct BENCH_SYSCALLS : SYSCALLS<SYS_OTHER, SYS_BENCH> {};
+
+static volatile int bench_counter;
+
+BENCH_NOINLINE static int bench_syscall(int fd, void*, int value) {
+	bench_counter = fd;
+	return fd + value;
+}
+
+static double run_call(BENCH_SYSCALLS & sys, const std::vector<int> & order, size_t rounds) {
+	uint64_t start = bench_now();
+	for (size_t r = 0; r < rounds; r++) {
+		for (int fd : order) {
+			bench_keep(sys.call<SYS_BENCH>(fd, 1));
+		}
+	}
+	return (double)(bench_now() - start) / (double)(rounds * order.size());
+}
+
+static double run_ring(SyscallRing<BENCH_SYSCALLS> & ring, size_t batch, const std::vector<int> & order, size_t rounds) {
+	uint64_t start = bench_now();
+	for (size_t r = 0; r < rounds; r++) {
+		size_t i = 0;
+		while (i < order.size()) {
+			size_t n = order.size() - i < batch ? order.size() - i : batch;
+			for (size_t k = 0; k < n; k++, i++) {
+				ring.prepare<SYS_BENCH>(order[i], i, 1);
+			}
+			ring.submit();
+			while (const SyscallCompletion * completion = ring.peek()) {
+				bench_keep(completion->result_as<int>());
+				ring.advance();
+			}
+		}
+	}
+	return (double)(bench_now() - start) / (double)(rounds * order.size());
+}
+
+int main() {
+	const size_t fd_count = 1 << 16;
+	const size_t calls_per_run = 1 << 20;
+	const size_t providers = 16;
+	size_t batches[] = { 1, 8, 64, 512 };
+
+	BENCH_SYSCALLS sys;
+	std::vector<SYSCALL_BASE::SyscallProvider*> provider_list;
+	for (size_t p = 0; p < providers; p++) {
+		SYSCALL_BASE::SyscallProvider & provider = sys.create_provider_entry();
+		sys.register_syscall<SYS_BENCH>(provider, &bench_syscall);
+		provider_list.push_back(&provider);
+	}
+	for (size_t i = 0; i < fd_count; i++) {
+		sys.allocate_fd(*provider_list[i % providers], nullptr, nullptr);
+	}
+
+	std::vector<int> order(calls_per_run);
+	bench_random rng(fd_count);
+	for (size_t i = 0; i < calls_per_run; i++) {
+		order[i] = (int)(rng.next() % fd_count);
+	}
+
+	SyscallRing<BENCH_SYSCALLS> ring(sys, 512);
+
+	// report the best of several runs, to filter out scheduling noise
+	const int repeats = 11;
+
+	printf("%-12s %18s\n", "mode", "per call (" LIBSYSCALL_BENCH_UNIT ")");
+	double best = run_call(sys, order, 1);
+	for (int k = 0; k < repeats; k++) {
+		double t = run_call(sys, order, 1);
+		if (t < best) best = t;
+	}
+	printf("%-12s %18.2f\n", "call", best);
+	for (size_t batch : batches) {
+		best = run_ring(ring, batch, order, 1);
+		for (int k = 0; k < repeats; k++) {
+			double t = run_ring(ring, batch, order, 1);
+			if (t < best) best = t;
+		}
+		char name[32];
+		snprintf(name, sizeof(name), "ring/%zu", batch);
+		printf("%-12s %18.2f\n", name, best);
+	}
+
+	for (size_t i = 0; i < fd_count; i++) {
+		sys.deallocate_fd(*provider_list[i % providers], (int)i);
+	}
+	return 0;
+}
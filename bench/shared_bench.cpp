@@ -0,0 +1,108 @@
+// measures what a call through a shared fd namespace costs, see 'syscall_shared.h'
+//
+// a forked child owns an fd and serves the calls made on it, the parent compares
+//  a plain call, a call on a global fd it owns itself, and a call forwarded to the child
+
+#include <libsyscall/syscall_shared.h>
+#include "bench_common.h"
+
+#include <sys/wait.h>
+#include <vector>
+#include <cstdio>
+
+#if defined(_MSC_VER)
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+struct SYS_BENCH : Syscall<SYS_BENCH, int(int)> {};
+struct SYS_STOP : Syscall<SYS_STOP, void()> {};
+
+struct BENCH_SYSCALLS : SYSCALLS<SYS_BENCH, SYS_STOP> {};
+
+static volatile int bench_counter;
+
+BENCH_NOINLINE static int bench_syscall(int fd, void*, int value) {
+	bench_counter = fd;
+	return fd + value;
+}
+
+static SyscallShared<BENCH_SYSCALLS> * child_shared;
+
+static void stop_syscall(int, void*) {
+	child_shared->stop();
+}
+
+template <typename F>
+static double best_of(F run) {
+	// report the best of several runs, to filter out scheduling noise
+	const int repeats = 11;
+	double best = run();
+	for (int k = 0; k < repeats; k++) {
+		double t = run();
+		if (t < best) best = t;
+	}
+	return best;
+}
+
+template <typename F>
+static double per_call(size_t count, F call) {
+	uint64_t start = bench_now();
+	for (size_t i = 0; i < count; i++) {
+		bench_keep(call((int)i));
+	}
+	return (double)(bench_now() - start) / (double)count;
+}
+
+int main() {
+	const size_t local_calls = 1 << 20;
+	const size_t remote_calls = 1 << 14;
+
+	SyscallSharedOptions options;
+	options.fds = 1024;
+	options.processes = 2;
+	SyscallSharedSegment segment(options);
+
+	// tells the parent which global fd the child shared
+	int ready[2];
+	if (pipe(ready) != 0) return 1;
+
+	pid_t child = fork();
+	if (child == 0) {
+		BENCH_SYSCALLS sys;
+		SYSCALL_BASE::SyscallProvider & provider = sys.create_provider_entry();
+		sys.register_syscall<SYS_BENCH>(provider, &bench_syscall);
+		sys.register_syscall<SYS_STOP>(provider, &stop_syscall);
+		int fd = sys.allocate_fd(provider, nullptr, nullptr);
+		{
+			SyscallShared<BENCH_SYSCALLS> shared(sys, segment);
+			child_shared = &shared;
+			int global = shared.share(fd);
+			if (write(ready[1], &global, sizeof(global)) != sizeof(global)) _exit(1);
+			shared.serve();
+		}
+		sys.deallocate_fd(provider, fd);
+		_exit(0);
+	}
+
+	BENCH_SYSCALLS sys;
+	SYSCALL_BASE::SyscallProvider & provider = sys.create_provider_entry();
+	sys.register_syscall<SYS_BENCH>(provider, &bench_syscall);
+	int fd = sys.allocate_fd(provider, nullptr, nullptr);
+	SyscallShared<BENCH_SYSCALLS> shared(sys, segment);
+	int local = shared.share(fd);
+	int remote;
+	if (read(ready[0], &remote, sizeof(remote)) != sizeof(remote)) return 1;
+
+	printf("%-16s %18s\n", "mode", "per call (" LIBSYSCALL_BENCH_UNIT ")");
+	printf("%-16s %18.2f\n", "call", best_of([&] { return per_call(local_calls, [&](int i) { return sys.call<SYS_BENCH>(fd, i); }); }));
+	printf("%-16s %18.2f\n", "shared/local", best_of([&] { return per_call(local_calls, [&](int i) { return shared.call<SYS_BENCH>(local, i); }); }));
+	printf("%-16s %18.2f\n", "shared/remote", best_of([&] { return per_call(remote_calls, [&](int i) { return shared.call<SYS_BENCH>(remote, i); }); }));
+
+	shared.call<SYS_STOP>(remote);
+	waitpid(child, nullptr, 0);
+	shared.unshare(local);
+	sys.deallocate_fd(provider, fd);
+	return 0;
+}
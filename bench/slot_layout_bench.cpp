@@ -0,0 +1,105 @@
+// compares the cost of resolving a syscall from an fd slot
+//
+//   legacy: slot -> heap Resource -> std::vector<void*>* -> vector buffer -> entry
+//   inline: slot { data, table } -> entry
+//
+// both layouts share the same fd allocator, so the difference is purely the pointer chasing after the slot lookup
+
+#include <libsyscall/libsyscall.h>
+#include "bench_common.h"
+
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+static volatile int bench_counter;
+
+#if defined(_MSC_VER)
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+BENCH_NOINLINE static int bench_syscall(int fd, void*) {
+	bench_counter = fd;
+	return fd;
+}
+
+struct LegacyResource {
+	std::vector<void*> * syscalls;
+	void* resource;
+};
+
+static const size_t SYSCALL_ID = 3;
+
+static double run_legacy(wl_syscalls__fd_allocator* fds, const std::vector<int> & order, size_t rounds) {
+	uint64_t start = bench_now();
+	for (size_t r = 0; r < rounds; r++) {
+		for (int fd : order) {
+			wl_syscalls__fd_allocator__slot* slot = wl_syscalls__fd_allocator__get_slot_from_fd(fds, fd);
+			LegacyResource& res = *(LegacyResource*)slot->data;
+			int (*callback)(int, void*) = (int (*)(int, void*))res.syscalls[0][SYSCALL_ID];
+			bench_keep(callback(fd, res.resource));
+		}
+	}
+	return (double)(bench_now() - start) / (double)(rounds * order.size());
+}
+
+static double run_inline(wl_syscalls__fd_allocator* fds, const std::vector<int> & order, size_t rounds) {
+	uint64_t start = bench_now();
+	for (size_t r = 0; r < rounds; r++) {
+		for (int fd : order) {
+			wl_syscalls__fd_allocator__slot* slot = wl_syscalls__fd_allocator__get_slot_from_fd(fds, fd);
+			int (*callback)(int, void*) = (int (*)(int, void*))static_cast<void* const*>(slot->table)[SYSCALL_ID];
+			bench_keep(callback(fd, slot->data));
+		}
+	}
+	return (double)(bench_now() - start) / (double)(rounds * order.size());
+}
+
+static std::vector<int> make_order(size_t fd_count, size_t length, bool random) {
+	std::vector<int> order(length);
+	bench_random rng(fd_count);
+	for (size_t i = 0; i < length; i++) {
+		order[i] = random ? (int)(rng.next() % fd_count) : (int)(i % fd_count);
+	}
+	return order;
+}
+
+int main() {
+	size_t fd_counts[] = { 1, 1024, 1 << 20 };
+	const size_t calls_per_run = 1 << 22;
+	const size_t providers = 64;
+
+	printf("%-10s %-10s %18s %18s\n", "fds", "order", "legacy (" LIBSYSCALL_BENCH_UNIT ")", "inline (" LIBSYSCALL_BENCH_UNIT ")");
+
+	for (size_t fd_count : fd_counts) {
+		// spread fds over several providers, each with its own separately allocated table, as a real process would
+		std::vector<std::vector<void*>> tables(providers, std::vector<void*>(8, (void*)&bench_syscall));
+
+		wl_syscalls__fd_allocator* legacy = wl_syscalls__fd_allocator__create();
+		wl_syscalls__fd_allocator* inline_slots = wl_syscalls__fd_allocator__create();
+		std::vector<LegacyResource*> resources(fd_count);
+		for (size_t i = 0; i < fd_count; i++) {
+			std::vector<void*>& table = tables[i % providers];
+			resources[i] = new LegacyResource { &table, nullptr };
+			wl_syscalls__fd_allocator__allocate_fd(legacy, resources[i], nullptr);
+			wl_syscalls__fd_allocator__allocate_fd_with_table(inline_slots, nullptr, table.data(), nullptr);
+		}
+
+		for (int random = 0; random < 2; random++) {
+			std::vector<int> order = make_order(fd_count, fd_count < calls_per_run ? calls_per_run : fd_count, random != 0);
+			// warm up both layouts once before measuring
+			run_legacy(legacy, order, 1);
+			run_inline(inline_slots, order, 1);
+			double l = run_legacy(legacy, order, 4);
+			double n = run_inline(inline_slots, order, 4);
+			printf("%-10zu %-10s %18.2f %18.2f\n", fd_count, random ? "random" : "sequential", l, n);
+		}
+
+		wl_syscalls__fd_allocator__destroy(legacy);
+		wl_syscalls__fd_allocator__destroy(inline_slots);
+		for (LegacyResource* res : resources) delete res;
+	}
+	return 0;
+}
@@ -0,0 +1,108 @@
+// measures what recording a trace adds to every event, and how fast a recorded trace replays
+//
+// the cost of a traced call is compared against the same call with no trace attached
+
+#define LIBSYSCALL_TRACE 1
+#include <libsyscall/syscall_replay.h>
+#include "bench_common.h"
+
+#include <vector>
+#include <cstdio>
+
+#if defined(_MSC_VER)
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+struct SYS_BENCH : Syscall<SYS_BENCH, int(int)> {};
+
+struct BENCH_SYSCALLS : SYSCALLS<SYS_BENCH> {};
+
+static volatile int bench_counter;
+
+BENCH_NOINLINE static int bench_syscall(int fd, void*, int value) {
+	bench_counter = fd;
+	return fd + value;
+}
+
+static double run_call(BENCH_SYSCALLS & sys, const std::vector<int> & order) {
+	uint64_t start = bench_now();
+	for (int fd : order) {
+		bench_keep(sys.call<SYS_BENCH>(fd, 1));
+	}
+	return (double)(bench_now() - start) / (double)order.size();
+}
+
+static double run_record(SyscallTrace & trace, size_t count) {
+	uint64_t start = bench_now();
+	for (size_t i = 0; i < count; i++) {
+		trace.record(SYSCALL_TRACE_CALL, (int)i, 0, 0, 4);
+	}
+	return (double)(bench_now() - start) / (double)count;
+}
+
+template <typename F>
+static double best_of(F run) {
+	// report the best of several runs, to filter out scheduling noise
+	const int repeats = 11;
+	double best = run();
+	for (int k = 0; k < repeats; k++) {
+		double t = run();
+		if (t < best) best = t;
+	}
+	return best;
+}
+
+int main() {
+	const size_t fd_count = 1 << 12;
+	const size_t calls_per_run = 1 << 20;
+
+	BENCH_SYSCALLS sys;
+	SYSCALL_BASE::SyscallProvider & provider = sys.create_provider_entry();
+	sys.register_syscall<SYS_BENCH>(provider, &bench_syscall);
+	for (size_t i = 0; i < fd_count; i++) {
+		sys.allocate_fd(provider, nullptr, nullptr);
+	}
+
+	std::vector<int> order(calls_per_run);
+	bench_random rng(fd_count);
+	for (size_t i = 0; i < calls_per_run; i++) {
+		order[i] = (int)(rng.next() % fd_count);
+	}
+
+	// large enough that a run never wraps
+	SyscallTrace trace(calls_per_run);
+
+	printf("%-16s %18s\n", "mode", "per event (" LIBSYSCALL_BENCH_UNIT ")");
+	double untraced = best_of([&] { return run_call(sys, order); });
+	printf("%-16s %18.2f\n", "call", untraced);
+	double traced = best_of([&] {
+		trace.clear();
+		sys.trace_start(trace);
+		double t = run_call(sys, order);
+		sys.trace_stop();
+		return t;
+	});
+	printf("%-16s %18.2f\n", "call/traced", traced);
+	printf("%-16s %18.2f\n", "record", best_of([&] { trace.clear(); return run_record(trace, calls_per_run); }));
+
+	trace.clear();
+	sys.trace_start(trace);
+	run_call(sys, order);
+	sys.trace_stop();
+	std::vector<SyscallTraceRecord> records = trace.records();
+	double replay = best_of([&] {
+		BENCH_SYSCALLS target;
+		SyscallReplay<BENCH_SYSCALLS> replayer(target);
+		uint64_t start = bench_now();
+		replayer.run(records);
+		return (double)(bench_now() - start) / (double)records.size();
+	});
+	printf("%-16s %18.2f\n", "replay", replay);
+
+	for (size_t i = 0; i < fd_count; i++) {
+		sys.deallocate_fd(provider, (int)i);
+	}
+	return 0;
+}
@@ -1,10 +1,10 @@
 ﻿#include <libsyscall/libsyscall.h>
 #include <iostream>
 
-struct MY_SYSCALLS : SYSCALL_BASE {
-	CREATE_SYSCALL0(SYS_READ, int);
-	CREATE_SYSCALL0(SYS_WRITE, void);
-};
+struct SYS_READ : Syscall<SYS_READ, int()> {};
+struct SYS_WRITE : Syscall<SYS_WRITE, void()> {};
+
+struct MY_SYSCALLS : SYSCALLS<SYS_READ, SYS_WRITE> {};
 
 static SYSCALL_BASE::SyscallProvider* register_syscalls();
 
@@ -25,33 +25,31 @@ static SYSCALL_BASE::SyscallProvider * register_syscalls() {
 
 	auto & res = SYS.instance().create_provider_entry();
 
-	SYS.instance().TMP__SYS_READ = +[](int fd, void*) {
+	SYS.instance().register_syscall<SYS_READ>(res, +[](int fd, void*) {
 		printf("read from fd %d\n", fd);
 		return 0;
-	};
-	res.syscalls[SYS.instance().x__SYS_READ__id] = (void*)SYS.instance().TMP__SYS_READ;
+	});
 
 	// register the close syscall
-	SYS.instance().TMP__SYS_WRITE = +[](int fd, void*) {
+	SYS.instance().register_syscall<SYS_WRITE>(res, +[](int fd, void*) {
 		printf("write to fd %d\n", fd);
-	};
-	res.syscalls[SYS.instance().x__SYS_WRITE__id] = (void*)SYS.instance().TMP__SYS_WRITE;
+	});
 
 	return &res;
 }
 
 static int sys_open() {
-	int fd = SYS.instance().allocate_fd(*provider, nullptr, +[](int fd, void**, bool) { SYS.instance().call_SYS_WRITE(fd); printf("closed fd %d\n", fd); });
+	int fd = SYS.instance().allocate_fd(*provider, nullptr, +[](int fd, void**, bool) { SYS.instance().call<SYS_WRITE>(fd); printf("closed fd %d\n", fd); });
 	printf("opened fd %d\n", fd);
 	return fd;
 }
 
 static int sys_read(int fd) {
-	return SYS.instance().call_SYS_READ(fd);
+	return SYS.instance().call<SYS_READ>(fd);
 }
 
 static void sys_write(int fd) {
-	SYS.instance().call_SYS_WRITE(fd);
+	SYS.instance().call<SYS_WRITE>(fd);
 }
 
 static void sys_close(int fd) {
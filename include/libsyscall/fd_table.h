@@ -0,0 +1,290 @@
+#ifndef LIBSYSCALL_FD_TABLE_H
+#define LIBSYSCALL_FD_TABLE_H
+
+#include <vector>
+#include <new>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// an integer fd table that stores a 'T' in place for every open fd
+//
+// FdTable<Connection> table;
+// int fd = table.allocate(socket, address); // constructs a Connection(socket, address) in the table
+// Connection * c = table.get(fd);           // nullptr if 'fd' is not open
+// table.deallocate(fd);                     // destroys it
+//
+// fd's live in chunks of doubling size, the same layout as ShrinkingVectorIndexAllocator,
+//  chunk 'c' holds fd's [2^(c+1) - 2, 2^(c+2) - 2)
+//
+// chunks never move, so a 'T*' stays valid until its fd is deallocated, even while other fd's are allocated,
+//  and the chunk pointers are an array inside the table itself, a lookup is one load of the chunk pointer and one of the entry
+//
+// the lowest free fd is always handed out first, and chunks at the end of the table are freed as soon as they are empty,
+//  a chunk below the highest open fd is freed too once it is empty, and allocated again when one of its fd's is handed out,
+//  except that the lowest empty one is kept as a spare, so that opening and closing a single fd does not free and allocate a chunk every time
+//
+// an FdTable is not thread safe, SYSCALL_BASE guards its own with its mutex
+//
+template <typename T>
+struct FdTable {
+	// chunk 29 ends at fd 2^31 - 3, the last fd an 'int' can hold in this layout
+	static constexpr size_t max_chunks = 30;
+
+	inline FdTable() {}
+
+	FdTable(const FdTable &) = delete;
+	FdTable & operator=(const FdTable &) = delete;
+
+	// destroys every 'T' still in the table, in fd order
+	inline ~FdTable() {
+		clear();
+	}
+
+	// the number of open fd's
+	inline size_t size() const { return count; }
+
+	// the number of fd's the allocated chunks can hold
+	inline size_t capacity() const { return resident; }
+
+	// one past the highest fd the table can currently hold
+	inline size_t limit() const { return chunk_count == 0 ? 0 : first_of(chunk_count); }
+
+	// constructs a 'T' from 'args' in the lowest free fd, and returns that fd
+	template <typename ... Args>
+	inline int allocate(Args && ... args) {
+		int fd;
+		if (!free_fds.empty()) {
+			std::pop_heap(free_fds.begin(), free_fds.end(), std::greater<int>());
+			fd = free_fds.back();
+			free_fds.pop_back();
+		}
+		else {
+			if ((size_t)next == first_of(max_chunks)) {
+				throw new std::runtime_error("FdTable ERROR: out of fd's");
+			}
+			size_t c = chunk_of(next);
+			if (c == chunk_count) grow();
+			fd = next++;
+		}
+		size_t c = chunk_of(fd);
+		if (chunks[c] == nullptr) chunks[c] = make_chunk(c);
+		if (spare == c) spare = max_chunks;
+		Entry & e = chunks[c][fd - first_of(c)];
+		try {
+			new (e.storage) T(std::forward<Args>(args)...);
+		}
+		catch (...) {
+			release(fd);
+			throw;
+		}
+		e.used = true;
+		live[c]++;
+		count++;
+		return fd;
+	}
+
+	// the 'T' of 'fd', nullptr if 'fd' is not open
+	inline T * get(int fd) {
+		Entry * e = entry(fd);
+		return e != nullptr && e->used ? e->value() : nullptr;
+	}
+
+	inline const T * get(int fd) const {
+		return const_cast<FdTable*>(this)->get(fd);
+	}
+
+	// invokes 'out(i, get(fds[i]))' for every i below 'count'
+	//
+	// entries are prefetched a fixed distance ahead of the one being read, so that their cache misses overlap
+	//  without issuing more prefetches at once than the core can keep in flight
+	//
+	template <typename F>
+	inline void get_many(const int * fds, size_t count, F && out) {
+		const size_t distance = count < prefetch_distance ? count : prefetch_distance;
+		for (size_t i = 0; i < distance; i++) {
+			prefetch(entry(fds[i]));
+		}
+		for (size_t i = 0; i < count; i++) {
+			if (i + distance < count) prefetch(entry(fds[i + distance]));
+			Entry * e = entry(fds[i]);
+			out(i, e != nullptr && e->used ? e->value() : nullptr);
+		}
+	}
+
+	// destroys the 'T' of 'fd', returns false if 'fd' is not open
+	inline bool deallocate(int fd) {
+		Entry * e = entry(fd);
+		if (e == nullptr || !e->used) return false;
+		e->used = false;
+		e->value()->~T();
+		live[chunk_of(fd)]--;
+		count--;
+		release(fd);
+		return true;
+	}
+
+	// invokes 'f(fd, value)' for every open fd, in fd order
+	//
+	// 'f' must not allocate or deallocate fd's
+	template <typename F>
+	inline void for_each(F && f) {
+		for (size_t c = 0; c < chunk_count; c++) {
+			if (live[c] == 0) continue;
+			size_t n = size_of(c);
+			for (size_t i = 0; i < n; i++) {
+				if (chunks[c][i].used) f((int)(first_of(c) + i), *chunks[c][i].value());
+			}
+		}
+	}
+
+	// invokes 'f(fd, value)' for every open fd in [begin, end), in fd order
+	//
+	// 'f' must not allocate or deallocate fd's, but disjoint ranges may be visited by several threads at once
+	template <typename F>
+	inline void for_each(int begin, int end, F && f) {
+		if (begin < 0) begin = 0;
+		for (size_t c = chunk_of((size_t)begin); c < chunk_count && (int)first_of(c) < end; c++) {
+			if (live[c] == 0) continue;
+			size_t first = first_of(c);
+			size_t from = (size_t)begin > first ? (size_t)begin - first : 0;
+			size_t to = std::min(size_of(c), (size_t)end - first);
+			for (size_t i = from; i < to; i++) {
+				if (chunks[c][i].used) f((int)(first + i), *chunks[c][i].value());
+			}
+		}
+	}
+
+	// destroys every 'T' in the table, in fd order, and frees all chunks
+	inline void clear() {
+		for (size_t c = 0; c < chunk_count; c++) {
+			size_t n = size_of(c);
+			for (size_t i = 0; live[c] != 0 && i < n; i++) {
+				if (!chunks[c][i].used) continue;
+				chunks[c][i].used = false;
+				chunks[c][i].value()->~T();
+				live[c]--;
+			}
+			::operator delete(chunks[c]);
+			chunks[c] = nullptr;
+		}
+		chunk_count = 0;
+		resident = 0;
+		spare = max_chunks;
+		count = 0;
+		next = 0;
+		free_fds.clear();
+	}
+
+private:
+	struct Entry {
+		alignas(T) unsigned char storage[sizeof(T)];
+		bool used;
+
+		inline T * value() { return std::launder(reinterpret_cast<T*>(storage)); }
+	};
+
+	Entry * chunks[max_chunks] = {};
+	size_t chunk_count = 0;
+	// the number of open fd's in every chunk
+	uint32_t live[max_chunks] = {};
+	size_t count = 0;
+	// the sum of the sizes of the allocated chunks
+	size_t resident = 0;
+	// the empty chunk below 'chunk_count' that is kept allocated, max_chunks if none
+	size_t spare = max_chunks;
+	// the lowest fd that has never been handed out since its chunk was allocated
+	int next = 0;
+	// a min-heap of the free fd's below 'next'
+	std::vector<int> free_fds;
+
+	static inline size_t chunk_of(size_t fd) {
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanReverse64(&index, (unsigned long long)fd + 2);
+		return (size_t)index - 1;
+#else
+		return (size_t)(63 - __builtin_clzll((unsigned long long)fd + 2)) - 1;
+#endif
+	}
+
+	static inline size_t first_of(size_t chunk) { return ((size_t)2 << chunk) - 2; }
+
+	static inline size_t size_of(size_t chunk) { return (size_t)2 << chunk; }
+
+	inline Entry * entry(int fd) {
+		if (fd < 0) return nullptr;
+		size_t c = chunk_of((size_t)fd);
+		if (c >= chunk_count || chunks[c] == nullptr) return nullptr;
+		return &chunks[c][(size_t)fd - first_of(c)];
+	}
+
+	// the number of entries 'get_many' prefetches ahead
+	static const size_t prefetch_distance = 16;
+
+	// an entry is not cache line aligned, 'used' can be on the line after its first byte
+	static inline void prefetch(const Entry * e) {
+#if defined(__GNUC__) || defined(__clang__)
+		if (e == nullptr) return;
+		__builtin_prefetch(e);
+		__builtin_prefetch(&e->used);
+#else
+		(void)e;
+#endif
+	}
+
+	inline Entry * make_chunk(size_t c) {
+		size_t n = size_of(c);
+		Entry * chunk = static_cast<Entry*>(::operator new(sizeof(Entry) * n));
+		for (size_t i = 0; i < n; i++) chunk[i].used = false;
+		resident += n;
+		return chunk;
+	}
+
+	inline void free_chunk(size_t c) {
+		::operator delete(chunks[c]);
+		chunks[c] = nullptr;
+		resident -= size_of(c);
+	}
+
+	inline void grow() {
+		chunks[chunk_count] = make_chunk(chunk_count);
+		live[chunk_count] = 0;
+		chunk_count++;
+	}
+
+	// returns a free fd to the table, and frees the chunks at the end of the table that became empty
+	inline void release(int fd) {
+		free_fds.push_back(fd);
+		std::push_heap(free_fds.begin(), free_fds.end(), std::greater<int>());
+		size_t c = chunk_of((size_t)fd);
+		if (live[chunk_count - 1] != 0) {
+			// an empty chunk in the middle of the table, the lower of it and the spare stays allocated
+			if (live[c] != 0 || c == spare) return;
+			if (spare == max_chunks) {
+				spare = c;
+				return;
+			}
+			free_chunk(std::max(c, spare));
+			spare = std::min(c, spare);
+			return;
+		}
+		while (chunk_count != 0 && live[chunk_count - 1] == 0) {
+			chunk_count--;
+			if (chunks[chunk_count] != nullptr) free_chunk(chunk_count);
+		}
+		if (spare >= chunk_count) spare = max_chunks;
+		next = (int)(chunk_count == 0 ? 0 : first_of(chunk_count));
+		free_fds.erase(std::remove_if(free_fds.begin(), free_fds.end(), [&](int free_fd) { return free_fd >= next; }), free_fds.end());
+		std::make_heap(free_fds.begin(), free_fds.end(), std::greater<int>());
+	}
+};
+
+#endif // LIBSYSCALL_FD_TABLE_H
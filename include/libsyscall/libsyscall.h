@@ -1,8 +1,27 @@
-﻿#include <vector>
+﻿#ifndef LIBSYSCALL_H
+#define LIBSYSCALL_H
+
+#include <vector>
+#include <deque>
+#include <new>
+#include <initializer_list>
 #include <utility>
 #include <string>
 #include <stdexcept>
+#include <type_traits>
+#include <optional>
+#include <memory>
+#include <functional>
+#include <tuple>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <cstdio>
+#include <cerrno>
 #include <libsyscall/wl_fd_allocator.h>
+#include <libsyscall/fd_table.h>
+#include <libsyscall/syscall_slab.h>
 
 // define this to 1 - enable
 // define this to 0 - disable
@@ -10,180 +29,2044 @@
 
 #if LIBSYSCALL_THREAD_SAFE
 #include <shared_mutex>
-#include <atomic>
-#if 0
+#include <mutex>
+
+// a shared mutex that may be re-entered by the thread holding it exclusively
+//
+// destroy callbacks are invoked while 'deallocate_fd' holds the mutex exclusively,
+//  and they are allowed to make syscalls on the fd being destroyed (or allocate/deallocate other fd's)
+//
+// a thread that already owns the mutex simply bumps a recursion count instead of locking again
+//
+struct libsyscall__recursive_shared_mutex {
+	std::shared_mutex mutex;
+	std::atomic<std::thread::id> owner = { std::thread::id() };
+	size_t recursion = 0;
+
+	inline void lock() {
+		std::thread::id self = std::this_thread::get_id();
+		if (owner.load(std::memory_order_relaxed) == self) {
+			recursion++;
+			return;
+		}
+		mutex.lock();
+		owner.store(self, std::memory_order_relaxed);
+		recursion = 1;
+	}
+
+	inline void unlock() {
+		if (--recursion == 0) {
+			owner.store(std::thread::id(), std::memory_order_relaxed);
+			mutex.unlock();
+		}
+	}
+
+	inline void lock_shared() {
+		if (owner.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+			recursion++;
+			return;
+		}
+		mutex.lock_shared();
+	}
+
+	inline void unlock_shared() {
+		if (owner.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+			recursion--;
+			return;
+		}
+		mutex.unlock_shared();
+	}
+};
+
+#define LIBSYSCALL__MUTEX_VARIABLE libsyscall__recursive_shared_mutex mutex;
+#define LIBSYSCALL__MUTEX_GUARD_VARIABLE std::lock_guard<libsyscall__recursive_shared_mutex> guard(mutex);
+#define LIBSYSCALL__MUTEX_SHARED_GUARD_VARIABLE std::shared_lock<libsyscall__recursive_shared_mutex> guard(mutex);
 
-#ifndef _LGPL_SOURCE
-#define _LGPL_SOURCE
-#define LIBSYSCALL_LGPL_SOURCE
+#include <libsyscall/syscall_epoch.h>
+
+#define LIBSYSCALL__EPOCH_VARIABLE libsyscall__epoch epoch;
+#define LIBSYSCALL__EPOCH_GUARD_ON(sys) libsyscall__epoch_guard epoch_guard((sys).epoch);
+#define LIBSYSCALL__EPOCH_SYNCHRONIZE epoch.synchronize();
+#else
+#define LIBSYSCALL__MUTEX_VARIABLE
+#define LIBSYSCALL__MUTEX_GUARD_VARIABLE
+#define LIBSYSCALL__MUTEX_SHARED_GUARD_VARIABLE
+#define LIBSYSCALL__EPOCH_VARIABLE
+#define LIBSYSCALL__EPOCH_GUARD_ON(sys)
+#define LIBSYSCALL__EPOCH_SYNCHRONIZE
 #endif
-#ifndef URCU_INLINE_SMALL_FUNCTIONS
-#define URCU_INLINE_SMALL_FUNCTIONS
-#define LIBSYSCALL_URCU_INLINE_SMALL_FUNCTIONS
+
+// define this to 1 - count calls and record latency histograms per (provider, syscall), see libsyscall/syscall_stats.h
+// define this to 0 - disable, 'call' and 'try_call' contain no instrumentation at all
+#ifndef LIBSYSCALL_STATS
+#define LIBSYSCALL_STATS 0
 #endif
 
-#include <urcu/urcu-bp.h>
+#if LIBSYSCALL_STATS
+#include <libsyscall/syscall_stats.h>
 
-#ifdef LIBSYSCALL_URCU_INLINE_SMALL_FUNCTIONS
-#undef URCU_INLINE_SMALL_FUNCTIONS
-#undef LIBSYSCALL_URCU_INLINE_SMALL_FUNCTIONS
+#define LIBSYSCALL__STATS_VARIABLE libsyscall__stats stats;
+#define LIBSYSCALL__STATS_PROVIDER_VARIABLE size_t libsyscall__provider = 0;
+#define LIBSYSCALL__STATS_PROVIDER_ARGUMENT , &libsyscall__provider
+#define LIBSYSCALL__STATS_SCOPE_VARIABLE(id) libsyscall__stats_scope libsyscall__scope(stats, libsyscall__provider, id);
+#define LIBSYSCALL__STATS_ERROR libsyscall__scope.error = true;
+#else
+#define LIBSYSCALL__STATS_VARIABLE
+#define LIBSYSCALL__STATS_PROVIDER_VARIABLE
+#define LIBSYSCALL__STATS_PROVIDER_ARGUMENT
+#define LIBSYSCALL__STATS_SCOPE_VARIABLE(id)
+#define LIBSYSCALL__STATS_ERROR
 #endif
 
-#ifdef LIBSYSCALL_LGPL_SOURCE
-#undef _LGPL_SOURCE
-#undef LIBSYSCALL_LGPL_SOURCE
+// set this to 1 to be able to record binary traces of fd and syscall activity, see 'trace_start'
+#ifndef LIBSYSCALL_TRACE
+#define LIBSYSCALL_TRACE 0
 #endif
 
-struct libsyscall__recursive_shared_mutex {
-	std::atomic_int32_t locked = { 0 };
-	std::recursive_mutex m;
-	std::shared_mutex mutex;
-	
-	inline void lock() {
-		locked.load() == 0 ? (void)mutex.lock() : (void)locked++;
-	}
-};
+#if LIBSYSCALL_TRACE
+#include <libsyscall/syscall_trace.h>
 
-#define LIBSYSCALL__MUTEX_VARIABLE std::shared_mutex mutex; std::atomic_bool locked = false;
-#define LIBSYSCALL__MUTEX_GUARD_VARIABLE std::lock_guard<libsyscall_recursive_shared_mutex> guard(mutex);
+#define LIBSYSCALL__TRACE_VARIABLE libsyscall__tracer tracer;
+#define LIBSYSCALL__TRACE(kind, fd, provider, id) tracer.record(kind, fd, provider, id);
+#define LIBSYSCALL__TRACE_ON(sys, kind, fd, provider, id) (sys).tracer.record(kind, fd, provider, id);
 #else
-#define LIBSYSCALL__MUTEX_VARIABLE std::shared_mutex mutex; std::atomic_bool locked = false;
-#define LIBSYSCALL__MUTEX_GUARD_VARIABLE std::lock_guard<std::shared_mutex> guard(mutex);
+#define LIBSYSCALL__TRACE_VARIABLE
+#define LIBSYSCALL__TRACE(kind, fd, provider, id)
+#define LIBSYSCALL__TRACE_ON(sys, kind, fd, provider, id)
 #endif
+
+// set this to 1 to be able to expire fd's that have not been called for a while, see 'set_idle_timeout'
+#ifndef LIBSYSCALL_IDLE
+#define LIBSYSCALL_IDLE 0
+#endif
+
+#if LIBSYSCALL_IDLE
+#include <libsyscall/syscall_idle.h>
+
+#define LIBSYSCALL__IDLE_VARIABLE libsyscall__idle_wheel idle; std::vector<int> idle_due;
+#define LIBSYSCALL__IDLE_RESOURCE_VARIABLE libsyscall__idle_node idle;
+#define LIBSYSCALL__IDLE_TOUCH(slot) libsyscall__idle_wheel::touch(resource_of(slot)->idle, idle.now());
+#define LIBSYSCALL__IDLE_CANCEL_ON(sys, resource) (sys).idle_cancel(resource);
 #else
-#define LIBSYSCALL__MUTEX_VARIABLE
-#define LIBSYSCALL__MUTEX_GUARD_VARIABLE
+#define LIBSYSCALL__IDLE_VARIABLE
+#define LIBSYSCALL__IDLE_RESOURCE_VARIABLE
+#define LIBSYSCALL__IDLE_TOUCH(slot)
+#define LIBSYSCALL__IDLE_CANCEL_ON(sys, resource)
 #endif
 
-#define CREATE_SYSCALL0(name, ret) \
-ret (*TMP__##name) (int, void *); \
-int x__##name##__id = +[this]() { syscalls.push_back(nullptr); return syscalls.size()-1; }(); \
-ret call_##name(int fd) { \
-	Resource& res = wl_miniobj_get_priv(fd); \
-	void * callback = res.syscalls[0][x__##name##__id]; \
-    if (callback != nullptr) return ((ret (*) (int, void *))callback)(fd, res.resource); \
-	throw new std::runtime_error("callback not supported"); \
-}
+// set this to 1 to be able to cache the results of syscalls per fd, see 'set_cacheable'
+#ifndef LIBSYSCALL_MEMO
+#define LIBSYSCALL_MEMO 0
+#endif
 
-#define CREATE_SYSCALL1(name, ret, p1) \
-ret (*TMP__##name) (int, void*, p1); \
-int x__##name##__id = +[this]() { syscalls.push_back(nullptr); return syscalls.size()-1; }(); \
-ret call_##name(int fd, p1 arg1) { \
-	Resource& res = wl_miniobj_get_priv(fd); \
-	void * callback = res.syscalls[0][x__##name##__id]; \
-    if (callback != nullptr) return ((ret (*) (int, void*, p1))callback)(fd, res.resource, arg1); \
-	throw new std::runtime_error("callback not supported"); \
-}
+#if LIBSYSCALL_MEMO
+#include <libsyscall/syscall_memo.h>
 
-#define CREATE_SYSCALL2(name, ret, p1, p2) \
-ret (*TMP__##name) (int, void*, p1, p2); \
-int x__##name##__id = +[this]() { syscalls.push_back(nullptr); return syscalls.size()-1; }(); \
-ret call_##name(int fd, p1 arg1, p2 arg2) { \
-	Resource& res = wl_miniobj_get_priv(fd); \
-	void * callback = res.syscalls[0][x__##name##__id]; \
-    if (callback != nullptr) return ((ret (*) (int, void*, p1, p2))callback)(fd, res.resource, arg1, arg2); \
-	throw new std::runtime_error("callback not supported"); \
-}
+#define LIBSYSCALL__MEMO_RESOURCE_VARIABLE libsyscall__memo memo;
+#define LIBSYSCALL__MEMO_PROVIDER_VARIABLE std::vector<bool> cacheable;
+#define LIBSYSCALL__MEMO_TABLE_VARIABLE const bool * cacheable;
+#define LIBSYSCALL__MEMO_PROBE_PARAMETER , libsyscall__memo_probe * probe = nullptr
+#define LIBSYSCALL__MEMO_PROBE(slot, table, id) if (probe != nullptr) memo_probe(resource_of(slot), table, id, probe);
+#define LIBSYSCALL__MEMO_PROBE_VARIABLE(R) libsyscall__memo_result<R> libsyscall__probe;
+#define LIBSYSCALL__MEMO_PROBE_ARGUMENT , &libsyscall__probe
+#define LIBSYSCALL__MEMO_RETURN_IF_HIT(R, result) if constexpr (libsyscall__memoizable<R>::value) { if (libsyscall__probe.hit) return result; }
+#define LIBSYSCALL__MEMO_RETURN_STORED(R, fd, call, result) if constexpr (libsyscall__memoizable<R>::value) { if (libsyscall__probe.store) { R value = call; memo_store(fd, libsyscall__probe, &value); return result; } }
+#else
+#define LIBSYSCALL__MEMO_RESOURCE_VARIABLE
+#define LIBSYSCALL__MEMO_PROVIDER_VARIABLE
+#define LIBSYSCALL__MEMO_TABLE_VARIABLE
+#define LIBSYSCALL__MEMO_PROBE_PARAMETER
+#define LIBSYSCALL__MEMO_PROBE(slot, table, id)
+#define LIBSYSCALL__MEMO_PROBE_VARIABLE(R)
+#define LIBSYSCALL__MEMO_PROBE_ARGUMENT
+#define LIBSYSCALL__MEMO_RETURN_IF_HIT(R, result)
+#define LIBSYSCALL__MEMO_RETURN_STORED(R, fd, call, result)
+#endif
 
-#define CREATE_SYSCALL3(name, ret, p1, p2, p3) \
-ret (*TMP__##name) (int, void*, p1, p2, p3); \
-int x__##name##__id = +[this]() { syscalls.push_back(nullptr); return syscalls.size()-1; }(); \
-ret call_##name(int fd, p1 arg1, p2 arg2, p3 arg3) { \
-	Resource& res = wl_miniobj_get_priv(fd); \
-	void * callback = res.syscalls[0][x__##name##__id]; \
-    if (callback != nullptr) return ((ret (*) (int, void*, p1, p2, p3))callback)(fd, res.resource, arg1, arg2, arg3); \
-	throw new std::runtime_error("callback not supported"); \
-}
+// the least number of open fd's per thread for 'set_teardown_threads' to use another thread
+#ifndef LIBSYSCALL_TEARDOWN_MIN_FDS
+#define LIBSYSCALL_TEARDOWN_MIN_FDS 16384
+#endif
 
-#define CREATE_SYSCALL4(name, ret, p1, p2, p3, p4) \
-ret (*TMP__##name) (int, void*, p1, p2, p3, p4); \
-int x__##name##__id = +[this]() { syscalls.push_back(nullptr); return syscalls.size()-1; }(); \
-ret call_##name(int fd, p1 arg1, p2 arg2, p3 arg3, p4 arg4) { \
-	Resource& res = wl_miniobj_get_priv(fd); \
-	void * callback = res.syscalls[0][x__##name##__id]; \
-    if (callback != nullptr) return ((ret (*) (int, void*, p1, p2, p3, p4))callback)(fd, res.resource, arg1, arg2, arg3, arg4); \
-	throw new std::runtime_error("callback not supported"); \
-}
+#if defined(__GNUC__) || defined(__clang__)
+#define LIBSYSCALL_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define LIBSYSCALL_PREFETCH(address)
+#endif
 
-#define CREATE_SYSCALL5(name, ret, p1, p2, p3, p4, p5) \
-ret (*TMP__##name) (int, void*, p1, p2, p3, p4, p5); \
-int x__##name##__id = +[this]() { syscalls.push_back(nullptr); return syscalls.size()-1; }(); \
-ret call_##name(int fd, p1 arg1, p2 arg2, p3 arg3, p4 arg4, p5 arg5) { \
-	Resource& res = wl_miniobj_get_priv(fd); \
-	void * callback = res.syscalls[0][x__##name##__id]; \
-    if (callback != nullptr) return ((ret (*) (int, void*, p1, p2, p3, p4, p5))callback)(fd, res.resource, arg1, arg2, arg3, arg4, arg5); \
-	throw new std::runtime_error("callback not supported"); \
-}
+// a syscall definition
+//
+// 'Tag' is any type that is unique to this syscall, usually the syscall itself
+//
+// 'Signature' is the syscall signature as seen by the caller, 'Ret(Args...)'
+//
+//   the provider implementation of a syscall additionally receives 'int fd, void* resource' as its first two arguments
+//
+// struct SYS_READ : Syscall<SYS_READ, int(char*, size_t)> {};
+//
+// here 'SYS_READ' is called as 'call<SYS_READ>(fd, buffer, length)'
+//  and is implemented by a 'int (*)(int fd, void* resource, char* buffer, size_t length)'
+//
+template <typename Tag, typename Signature>
+struct Syscall;
 
-#define CREATE_SYSCALL6(name, ret, p1, p2, p3, p4, p5, p6) \
-ret (*TMP__##name) (int, void*, p1, p2, p3, p4, p5, p6); \
-int x__##name##__id = +[this]() { syscalls.push_back(nullptr); return syscalls.size()-1; }(); \
-ret call_##name(int fd, p1 arg1, p2 arg2, p3 arg3, p4 arg4, p5 arg5, p6 arg6) { \
-	Resource& res = wl_miniobj_get_priv(fd); \
-	void * callback = res.syscalls[0][x__##name##__id]; \
-    if (callback != nullptr) return ((ret (*) (int, void*, p1, p2, p3, p4, p5, p6))callback)(fd, res.resource, arg1, arg2, arg3, arg4, arg5, arg6); \
-	throw new std::runtime_error("callback not supported"); \
-}
+template <typename Tag, typename Ret, typename ... Args>
+struct Syscall<Tag, Ret(Args...)> {
+	using tag = Tag;
+	using return_type = Ret;
+	using function_type = Ret(*)(int, void*, Args...);
+	// the arguments of a deferred call, see 'call_async'
+	using argument_tuple = std::tuple<typename std::decay<Args>::type...>;
+	// an optional provider implementation that handles many fd's of the same provider at once, see 'call_many'
+	//
+	//   'fds' and 'resources' hold 'count' entries, 'results' is nullptr for syscalls returning void
+	using batch_function_type = void(*)(const int * fds, void * const * resources, size_t count, typename std::conditional<std::is_void<Ret>::value, std::nullptr_t, Ret*>::type results, Args...);
+};
+
+template <typename S, typename ... List>
+struct libsyscall__index_of {
+	static_assert(sizeof(S) == 0, "syscall is not part of this syscall table");
+};
+
+template <typename S, typename ... Rest>
+struct libsyscall__index_of<S, S, Rest...> : std::integral_constant<size_t, 0> {};
+
+template <typename S, typename First, typename ... Rest>
+struct libsyscall__index_of<S, First, Rest...> : std::integral_constant<size_t, 1 + libsyscall__index_of<S, Rest...>::value> {};
+
+// passed to 'allocate_fd' along with a resource made by 'SyscallProvider::make_resource' of the same provider
+struct SyscallPooled {};
+
+// the result of a non-throwing syscall, see 'try_call'
+//
+// holds either the value returned by the syscall, or an errno style error code
+//
+//   EBADF  - the fd is invalid
+//   ENOSYS - the fd's provider does not implement the syscall
+//
+// nothing is allocated on either path
+//
+template <typename T>
+struct SyscallResult {
+	static_assert(!std::is_reference<T>::value, "try_call does not support syscalls that return a reference");
+
+	std::optional<T> result;
+	int error_code = 0;
+
+	inline SyscallResult(T && value) : result(std::move(value)) {}
+	inline SyscallResult(const T & value) : result(value) {}
+	static inline SyscallResult failure(int error) { SyscallResult r; r.error_code = error; return r; }
+
+	inline bool ok() const { return error_code == 0; }
+	inline explicit operator bool() const { return ok(); }
+	inline int error() const { return error_code; }
+	inline T & value() { return *result; }
+	inline const T & value() const { return *result; }
+	inline T & operator*() { return *result; }
+	inline const T & operator*() const { return *result; }
+	inline T value_or(T fallback) const { return ok() ? *result : fallback; }
+
+private:
+	inline SyscallResult() {}
+};
+
+template <>
+struct SyscallResult<void> {
+	int error_code = 0;
+
+	inline SyscallResult() {}
+	static inline SyscallResult failure(int error) { SyscallResult r; r.error_code = error; return r; }
+
+	inline bool ok() const { return error_code == 0; }
+	inline explicit operator bool() const { return ok(); }
+	inline int error() const { return error_code; }
+};
+
+struct SyscallStaticProvider;
+
+// a unique address per syscall list, identifies the syscall table a 'SyscallStaticProvider' was defined for
+template <typename List>
+struct libsyscall__table_tag {
+	static constexpr char tag = 0;
+};
+
+template <typename ... Syscalls>
+struct libsyscall__syscall_list;
 
 struct SYSCALL_BASE {
 public:
+	struct SyscallProvider;
+	struct SyscallHooks;
+
+	// an immutable, versioned snapshot of a provider's syscalls, one entry per syscall id,
+	//  followed by one batch entry per syscall id (see 'call_many')
+	//
+	// fd slots point at their provider, dispatch loads the provider's current table from the slot and then the entry
+	//
+	// a table is never modified once published, 'publish' builds a new version and atomically replaces the old one,
+	//  no fd refers to a table, so that is all it takes to move every fd of the provider to the new version
+	//
+	// tables are reference counted, the provider holds one reference to its current table and every handle using it holds one more,
+	//  see 'SYSCALLS::handle', and so does every call of an intercepted entry that is in flight, see 'SyscallHooks',
+	//  a replaced table is freed once the last of them is done with it
+	//
+	struct SyscallTable {
+		SyscallProvider * provider;
+		// copied from the provider, see 'SyscallProvider::index'
+		size_t provider_index;
+		uint64_t version;
+		std::atomic<size_t> references;
+		size_t size;
+		// nullptr unless the provider has interceptors or permissions, otherwise one flag per entry, see 'add_interceptor'
+		const bool * intercepted;
+		// owns 'intercepted' and the entries it flags, nullptr along with it
+		SyscallHooks * hooks;
+		// nullptr unless the provider has cacheable syscalls, otherwise one flag per syscall id, see 'set_cacheable'
+		LIBSYSCALL__MEMO_TABLE_VARIABLE
+		void* syscalls[1];
+
+		static inline SyscallTable* create(SyscallProvider * provider, uint64_t version, const std::vector<void*> & syscalls) {
+			size_t n = syscalls.size() == 0 ? 1 : syscalls.size();
+			size_t flags = 0;
+#if LIBSYSCALL_MEMO
+			// the cacheable flags are stored right after the entries
+			flags = provider->cacheable.size();
+#endif
+			void * memory = ::operator new(sizeof(SyscallTable) + sizeof(void*) * (n - 1) + flags);
+			SyscallTable * table = new (memory) SyscallTable();
+			table->provider = provider;
+			table->provider_index = provider->index;
+			table->version = version;
+			table->references.store(1, std::memory_order_relaxed);
+			table->size = syscalls.size();
+			table->intercepted = nullptr;
+			table->hooks = nullptr;
+			for (size_t i = 0; i < syscalls.size(); i++) table->syscalls[i] = syscalls[i];
+#if LIBSYSCALL_MEMO
+			bool * cacheable = reinterpret_cast<bool*>(&table->syscalls[n]);
+			for (size_t i = 0; i < flags; i++) cacheable[i] = provider->cacheable[i];
+			table->cacheable = flags == 0 ? nullptr : cacheable;
+#endif
+			return table;
+		}
+
+		// true if entry 'id' is a 'SyscallIntercepted*' rather than the implementation itself
+		inline bool intercepts(size_t id) const {
+			return intercepted != nullptr && intercepted[id];
+		}
+
+		inline void reference() {
+			references.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		inline void release() {
+			if (references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				delete hooks;
+				this->~SyscallTable();
+				::operator delete(this);
+			}
+		}
+	};
+
+	// a hook around every syscall of a provider, see 'add_interceptor'
+	struct SyscallInterceptor {
+		// runs before the syscall, returns 0 to let it proceed or an errno style error to fail it with
+		//
+		// 'arguments[i]' points at the i'th argument of the call, a hook may modify the arguments through it
+		int (*pre)(void * user, int fd, void * resource, size_t id, void * const * arguments) = nullptr;
+		// runs after the syscall has returned, 'result' points at its return value, nullptr for syscalls returning void
+		void (*post)(void * user, int fd, void * resource, size_t id, void * result) = nullptr;
+		void * user = nullptr;
+	};
+
 	struct SyscallProvider {
+		// the staged entries, one per syscall id, these are copied into a new table on every 'publish'
 		std::vector<void*> syscalls;
+
+		// newest first, see 'add_interceptor'
+		std::vector<SyscallInterceptor> interceptors;
+
+		// one flag per syscall id, empty - every syscall is permitted, see 'set_permissions'
+		std::vector<bool> permitted;
+
+		// one flag per syscall id, empty - nothing is cached, see 'set_cacheable'
+		LIBSYSCALL__MEMO_PROVIDER_VARIABLE
+
+		// the live table
+		std::atomic<SyscallTable*> table = { nullptr };
+
+		// bumped on every 'publish'
+		uint64_t version = 0;
+
+		// the position of this provider in its SYSCALL_BASE, in creation order
+		size_t index = 0;
+
+		// false - the destroy callbacks of this provider's fd's are skipped when the SYSCALL_BASE is destroyed,
+		//  for resources that need no cleanup at exit (their 'make_resource' objects are still destroyed)
+		bool teardown_callbacks = true;
+
+		// one pool per type, see 'make_resource'
+		libsyscall__slabs slabs;
+
+		// the provider whose entries fill the ones this provider leaves unset, see 'set_parent'
+		SyscallProvider * parent = nullptr;
+		std::vector<SyscallProvider*> children;
+
 		inline SyscallProvider() {}
-		inline SyscallProvider(std::vector<void*> syscalls) : syscalls(syscalls) {}
+		inline SyscallProvider(std::vector<void*> syscalls, size_t index) : syscalls(syscalls), index(index) {}
+
+		inline SyscallTable * current() const { return table.load(std::memory_order_acquire); }
+
+		// constructs a 'T' from 'args' in this provider's pool of 'T's
+		//
+		// pass it to 'allocate_fd' of this provider and it is destroyed and returned to the pool once the fd is deallocated,
+		//  right after its destroy callback, which no longer needs to free it (see 'destroy_fd'),
+		//  pass 'SyscallPooled()' along with it and 'allocate_fd' finds its pool without searching the provider's pools
+		//
+		// every thread keeps a few free blocks per pool, so this and the release usually take no lock, whichever thread they happen on
+		//
+		// objects still alive when the provider goes away (with its SYSCALL_BASE) are destroyed in bulk
+		template <typename T, typename ... Args>
+		inline T * make_resource(Args && ... args) {
+			libsyscall__slab & slab = slabs.of<T>();
+			void * block = slab.acquire();
+			try {
+				return new (block) T(std::forward<Args>(args)...);
+			}
+			catch (...) {
+				slab.abandon(block);
+				throw;
+			}
+		}
+
+		// destroys a 'T' made by 'make_resource' that was never passed to 'allocate_fd'
+		template <typename T>
+		inline void destroy_resource(T * resource) {
+			if (resource != nullptr) slabs.of<T>().release(resource);
+		}
 	};
-	struct Resource {
-		std::vector<void*> * syscalls;
-		void* resource = nullptr;
-		inline Resource() {}
-		inline Resource(SyscallProvider & provider, void * resource) : syscalls(&provider.syscalls), resource(resource) {}
+
+	// the hooks of a 'SyscallInterceptor', without the ones it leaves nullptr
+	struct SyscallPreHook {
+		int (*hook)(void * user, int fd, void * resource, size_t id, void * const * arguments);
+		void * user;
+	};
+
+	struct SyscallPostHook {
+		void (*hook)(void * user, int fd, void * resource, size_t id, void * result);
+		void * user;
+	};
+
+	// the table entry of a syscall of a provider with interceptors or permissions
+	//
+	// the hooks are copied out of the interceptors when the table is published, in the order they run,
+	//  so a call walks two plain arrays with nothing to skip
+	struct SyscallIntercepted {
+		void * callback;
+		size_t id;
+		// EPERM if the syscall is not permitted, the call fails without running any hooks
+		int error;
+		const SyscallPreHook * pre;
+		size_t pre_count;
+		const SyscallPostHook * post;
+		size_t post_count;
+		// the table this entry belongs to, see 'SyscallHooks'
+		SyscallTable * table;
+	};
+
+	// the intercepted entries of a table published with interceptors or permissions, owned by the table and freed along with it
+	//
+	// a call may still be using an entry after its table has been replaced, so whatever resolves an intercepted entry
+	//  takes a reference to its table while it still holds the lock, and releases it once the call is done, see 'SyscallEntryReference'
+	struct SyscallHooks {
+		std::vector<SyscallPreHook> pre;
+		std::vector<SyscallPostHook> post;
+		std::vector<SyscallIntercepted> entries;
+		std::unique_ptr<bool[]> intercepted;
 	};
+
+	// releases the table reference taken for 'entry' if it is intercepted, see 'SyscallHooks'
+	struct SyscallEntryReference {
+		SyscallTable * table;
+
+		inline SyscallEntryReference(void * entry, bool intercepted) : table(intercepted ? static_cast<SyscallIntercepted*>(entry)->table : nullptr) {}
+		inline ~SyscallEntryReference() { if (table != nullptr) table->release(); }
+
+		SyscallEntryReference(const SyscallEntryReference &) = delete;
+		SyscallEntryReference & operator=(const SyscallEntryReference &) = delete;
+	};
+
+	// a single syscall assignment, see 'SYSCALLS::entry' for a type-checked way to create one
+	struct SyscallEntry {
+		size_t id;
+		void * callback;
+	};
+
+	// an fd slot, 'data' is the resource passed to 'allocate_fd' and 'table' is its 'SyscallProvider*'
+	//
+	// dispatch loads both from the slot, then loads the provider's current table and the syscall from it
+	//
+	using Slot = wl_syscalls__fd_allocator__slot;
+
 	LIBSYSCALL__MUTEX_VARIABLE
+	// see 'publish', entered by readers of the tables that do not hold 'mutex'
+	LIBSYSCALL__EPOCH_VARIABLE
+	LIBSYSCALL__STATS_VARIABLE
+	LIBSYSCALL__TRACE_VARIABLE
 protected:
-	std::vector<SyscallProvider> provider_table;
-	std::vector<void*> syscalls;
-	wl_syscalls__fd_allocator* descriptor_list;
+	// a deque never moves its elements, references returned by 'create_provider_entry' stay valid
+	std::deque<SyscallProvider> provider_table;
+	// the 'libsyscall__table_tag' of this instance's syscall list, set by 'SYSCALLS'
+	const void * static_table = nullptr;
+	// set once the static providers have been registered, 'static_providers' is read-only from then on
+	std::atomic<bool> static_registered = { false };
+	// sorted by descriptor
+	std::vector<std::pair<const SyscallStaticProvider*, SyscallProvider*>> static_providers;
+	size_t syscall_count;
 
-	Resource& wl_miniobj_get_priv(int fd) {
-		LIBSYSCALL__MUTEX_GUARD_VARIABLE
+	// what the fd table holds for every fd, 'slot' is first so that a 'Slot*' is also a 'Resource*'
+	struct Resource {
+		Slot slot;
+		WL_SYSCALLS_FD_ALLOCATOR_CALLBACK___DESTROY_DATA callback;
+		// see 'pin'
+		std::atomic<size_t> pins;
+		// the pool 'slot.data' was made in, nullptr if it was not made by 'SyscallProvider::make_resource'
+		libsyscall__slab * slab;
+		// see 'set_idle_timeout'
+		LIBSYSCALL__IDLE_RESOURCE_VARIABLE
+		// see 'set_cacheable'
+		LIBSYSCALL__MEMO_RESOURCE_VARIABLE
+
+		inline Resource(void * data, void * table, WL_SYSCALLS_FD_ALLOCATOR_CALLBACK___DESTROY_DATA callback, libsyscall__slab * slab) : slot({ data, table }), callback(callback), pins(0), slab(slab) {}
+	};
+	FdTable<Resource> descriptor_list;
+	LIBSYSCALL__IDLE_VARIABLE
+
+	static inline Resource * resource_of(Slot * slot) {
+		return reinterpret_cast<Resource*>(slot);
+	}
+
+#if LIBSYSCALL_IDLE
+	// the wheel links fd's, this resolves them to their nodes, the caller must hold 'mutex' exclusively
+	inline libsyscall__idle_node & idle_node(int fd) {
+		return descriptor_list.get(fd)->idle;
+	}
+
+	inline void idle_cancel(Resource * resource) {
+		idle.cancel(resource->idle, [this](int other) -> libsyscall__idle_node & { return idle_node(other); });
+	}
+
+	// links the timer of 'fd' at 'deadline', or at the next tick if 'deadline' has already passed
+	inline void idle_schedule(int fd, Resource * resource, uint64_t deadline) {
+		resource->idle.deadline = deadline > idle.now() ? deadline : idle.now() + 1;
+		idle.insert(fd, resource->idle, [this](int other) -> libsyscall__idle_node & { return idle_node(other); });
+	}
+#endif
+
+	// see 'set_teardown_threads'
+	size_t teardown_threads = 1;
+
+	// the number of 'SyscallNamespace's sharing this instance's providers, see libsyscall/syscall_namespace.h
+	//
+	// only counted, 'publish' never visits a namespace, it waits for the epoch while there are any
+	std::atomic<size_t> namespaces = { 0 };
+	template <typename Table> friend struct SyscallNamespace;
+
+	// the destructor's work for the fd's in [begin, end), run by every teardown thread on a range of its own
+	//
+	// the fd table is only read, the entries are destroyed by the 'clear' that follows, so the threads share no counter
+	inline void teardown_range(int begin, int end) {
+		descriptor_list.for_each(begin, end, [&](int fd, Resource & resource) {
+			void * data = resource.slot.data;
+			WL_SYSCALLS_FD_ALLOCATOR_CALLBACK___DESTROY_DATA callback = take_callback(&resource, true);
+			if (callback != nullptr) callback(fd, &resource.slot.data, true);
+			// the pools are destroyed right after this, so the objects are only destroyed, not returned
+			if (resource.slab != nullptr && resource.slot.data == data) resource.slab->retire(data);
+			resource.slab = nullptr;
+		});
+	}
+
+	// splits the fd table into one range per thread, see 'set_teardown_threads'
+	inline void teardown_parallel(size_t threads) {
+		int end = (int)descriptor_list.limit();
+		int step = (int)((descriptor_list.limit() + threads - 1) / threads);
+		std::vector<std::thread> workers;
+		for (size_t t = 1; t < threads; t++) {
+			int begin = (int)t * step;
+			if (begin >= end) break;
+			workers.emplace_back([this, begin, step, end] { teardown_range(begin, std::min(begin + step, end)); });
+		}
+		teardown_range(0, std::min(step, end));
+		for (std::thread & worker : workers) worker.join();
+		descriptor_list.clear();
+	}
+
+	// fd's whose close was deferred because they were pinned, see 'pin'
+	//
+	// the slot of a closing fd has its provider cleared so that it no longer resolves,
+	//  its provider is kept here until the last pin is gone and the fd is actually deallocated
+	struct Closing {
+		int fd;
+		SyscallProvider * provider;
+	};
+	std::vector<Closing> closing;
+
+	// invoked whenever an fd is closed, see 'add_close_observer'
+	struct CloseObserver {
+		void (*callback)(void * user, int fd);
+		void * user;
+	};
+	std::vector<CloseObserver> close_observers;
+
+	// the current table of the provider of an open fd, the caller must hold 'mutex'
+	static inline SyscallTable * table_of(Slot * slot) {
+		return static_cast<SyscallProvider*>(slot->table)->table.load(std::memory_order_relaxed);
+	}
+
+	// returns nullptr if 'fd' is invalid, never throws
+	//
+	// the caller must hold 'mutex'
+	inline Slot* lookup(int fd) {
+		Resource * resource = descriptor_list.get(fd);
+		return resource == nullptr ? nullptr : &resource->slot;
+	}
+
+	// looks up 'count' fd's at once, 'slots[i]' is nullptr if 'fds[i]' is invalid
+	inline void lookup_many(const int * fds, size_t count, Slot ** slots) {
+		descriptor_list.get_many(fds, count, [slots](size_t i, Resource * resource) {
+			slots[i] = resource == nullptr ? nullptr : &resource->slot;
+		});
+	}
+
+	// the destroy callback of 'resource', nullptr if it is skipped, see 'SyscallProvider::teardown_callbacks'
+	inline WL_SYSCALLS_FD_ALLOCATOR_CALLBACK___DESTROY_DATA take_callback(Resource * resource, bool in_destructor) {
+		WL_SYSCALLS_FD_ALLOCATOR_CALLBACK___DESTROY_DATA callback = resource->callback;
+		resource->callback = nullptr;
+		if (in_destructor && !static_cast<SyscallProvider*>(resource->slot.table)->teardown_callbacks) return nullptr;
+		return callback;
+	}
+
+	// runs the destroy callback of 'fd' while 'fd' is still valid, then frees its entry
+	//
+	// the callback may make syscalls on 'fd', and allocate or deallocate other fd's
+	//
+	// a resource made by 'make_resource' is released to its pool afterwards, unless the callback changed '*data' to keep it
+	inline void destroy_fd(int fd, bool in_destructor) {
+		Resource * resource = descriptor_list.get(fd);
+		LIBSYSCALL__IDLE_CANCEL_ON(*this, resource)
+		void * data = resource->slot.data;
+		libsyscall__slab * slab = resource->slab;
+		WL_SYSCALLS_FD_ALLOCATOR_CALLBACK___DESTROY_DATA callback = take_callback(resource, in_destructor);
+		if (callback != nullptr) callback(fd, &resource->slot.data, in_destructor);
+		bool release = slab != nullptr && resource->slot.data == data;
+		descriptor_list.deallocate(fd);
+		// the pools go away with the instance, so there is no point in returning blocks to them
+		if (release && in_destructor) slab->retire(data);
+		else if (release) slab->release(data);
+	}
+
+	// resolves the resource of 'fd' and its implementation of syscall 'id'
+	//
+	// both are loaded under a shared lock, which is also what keeps the provider's table alive while it is read
+	//  once the entry has been loaded the table itself is no longer needed,
+	//  so an in-flight call finishes on the table it started with even if it is replaced concurrently
+	//
+	// returns false if 'fd' is invalid, '*callback' is nullptr if the provider does not implement 'id'
+	//
+	// '*intercepted' is set if '*callback' is a 'SyscallIntercepted*', see 'libsyscall__intercept',
+	//  its table is then referenced for the caller, who must release it with a 'SyscallEntryReference'
+	//
+	// '*provider_index' receives the index of the fd's provider if it is not nullptr
+	//
+	// with LIBSYSCALL_MEMO, '*probe' also looks up the cached result of 'id' if it is cacheable, see 'set_cacheable'
+	inline bool resolve(int fd, size_t id, void ** data, void ** callback, bool * intercepted, size_t * provider_index = nullptr LIBSYSCALL__MEMO_PROBE_PARAMETER) {
+		LIBSYSCALL__MUTEX_SHARED_GUARD_VARIABLE
+		Slot* slot = lookup(fd);
+		if (slot == nullptr || slot->table == nullptr) {
+			LIBSYSCALL__TRACE(SYSCALL_TRACE_CALL, fd, SYSCALL_TRACE_NO_PROVIDER, id)
+			return false;
+		}
+		SyscallTable * table = table_of(slot);
+		LIBSYSCALL__TRACE(SYSCALL_TRACE_CALL, fd, table->provider_index, id)
+		LIBSYSCALL__IDLE_TOUCH(slot)
+		*data = slot->data;
+		*callback = table->syscalls[id];
+		*intercepted = table->intercepts(id);
+		if (*intercepted) table->reference();
+		if (provider_index != nullptr) *provider_index = table->provider_index;
+		LIBSYSCALL__MEMO_PROBE(slot, table, id)
+		return true;
+	}
+
+#if LIBSYSCALL_MEMO
+	inline bool resolve(int fd, size_t id, void ** data, void ** callback, bool * intercepted, libsyscall__memo_probe * probe) {
+		return resolve(fd, id, data, callback, intercepted, nullptr, probe);
+	}
+
+	// looks up the cached result of 'id' for a call that is being resolved, the caller must hold 'mutex'
+	//
+	// intercepted entries are never cached, so that every call of them still runs its hooks
+	inline void memo_probe(Resource * resource, SyscallTable * table, size_t id, libsyscall__memo_probe * probe) {
+		if (probe->size == 0 || table->cacheable == nullptr || !table->cacheable[id] || table->intercepts(id)) return;
+		probe->key = libsyscall__memo::key_of(id, table->version);
+		probe->hit = resource->memo.find(probe->key, probe->result, probe->size, &probe->sequence);
+		probe->store = !probe->hit;
+	}
+
+	// caches the result of a call that missed, unless 'fd' was closed, invalidated or stored to since it was resolved
+	inline void memo_store(int fd, libsyscall__memo_probe & probe, const void * result) {
+		LIBSYSCALL__MUTEX_SHARED_GUARD_VARIABLE
+		Slot * slot = lookup(fd);
+		if (slot == nullptr) return;
+		resource_of(slot)->memo.store(probe.key, result, probe.size, probe.sequence);
+	}
+#endif
+
+public:
+	// a resolved batch entry, see 'resolve_batch'
+	struct SyscallResolved {
+		void * data;
+		void * callback;
+		// nullptr if the fd is invalid
+		SyscallProvider * provider;
+		// see 'resolve'
+		bool intercepted;
+	};
+
+	// resolves 'count' fd/syscall pairs under a single shared lock
+	//
+	// 'ids[i]' is the syscall id of the i'th entry
+	//
+	// the slots are looked up in one pass so that their cache misses overlap, see 'FdTable::get_many'
+	//
+	// the table of every intercepted entry is referenced, see 'resolve'
+	//
+	inline void resolve_batch(size_t count, const int * fds, const uint32_t * ids, SyscallResolved * out) {
+		LIBSYSCALL__MUTEX_SHARED_GUARD_VARIABLE
+		descriptor_list.get_many(fds, count, [&](size_t i, Resource * resource) {
+			Slot * slot = resource == nullptr ? nullptr : &resource->slot;
+			if (slot == nullptr || slot->table == nullptr) {
+				LIBSYSCALL__TRACE(SYSCALL_TRACE_CALL, fds[i], SYSCALL_TRACE_NO_PROVIDER, ids[i])
+				out[i] = { nullptr, nullptr, nullptr, false };
+				return;
+			}
+			SyscallTable * table = table_of(slot);
+			LIBSYSCALL__TRACE(SYSCALL_TRACE_CALL, fds[i], table->provider_index, ids[i])
+			LIBSYSCALL__IDLE_TOUCH(slot)
+			bool intercepted = table->intercepts(ids[i]);
+			if (intercepted) table->reference();
+			out[i] = { slot->data, table->syscalls[ids[i]], table->provider, intercepted };
+		});
+	}
+
+	// the table index of the batch entry of syscall 'id'
+	inline size_t batch_id(size_t id) const {
+		return syscall_count + id;
+	}
+
+	// a run of resolved fd's sharing a provider, see 'resolve_many'
+	struct SyscallGroup {
+		size_t begin;
+		size_t end;
+		void * callback;
+		void * batch;
+		// see 'resolve', a provider with interceptors never has a batch entry
+		bool intercepted;
+	};
+
+	// the output of 'resolve_many', reusable across calls
+	//
+	// 'order', 'fds' and 'data' list the valid fd's grouped by provider, 'order' holds their position in the input
+	//
+	// the tables of intercepted groups stay referenced until 'release' (or the next 'resolve_many', or the destructor)
+	struct SyscallGroups {
+		std::vector<Slot*> slots;
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> order;
+		std::vector<int> fds;
+		std::vector<void*> data;
+		std::vector<SyscallGroup> groups;
+		// a 'std::vector<R>' for the batch results of 'call_many', see 'results_of'
+		void * results = nullptr;
+		void (*destroy_results)(void * results) = nullptr;
+
+		inline SyscallGroups() {}
+		SyscallGroups(const SyscallGroups &) = delete;
+		SyscallGroups & operator=(const SyscallGroups &) = delete;
+
+		inline ~SyscallGroups() {
+			release();
+			if (results != nullptr) destroy_results(results);
+		}
+
+		// an empty buffer of 'R's that keeps its capacity across calls with the same 'R'
+		template <typename R>
+		inline std::vector<R> & results_of() {
+			void (*destroy)(void *) = +[](void * results) { delete static_cast<std::vector<R>*>(results); };
+			if (destroy_results != destroy) {
+				if (results != nullptr) destroy_results(results);
+				results = new std::vector<R>();
+				destroy_results = destroy;
+			}
+			return *static_cast<std::vector<R>*>(results);
+		}
+
+		inline void release() {
+			for (const SyscallGroup & group : groups) {
+				if (group.intercepted) static_cast<SyscallIntercepted*>(group.callback)->table->release();
+			}
+			groups.clear();
+		}
+	};
+
+	// resolves syscall 'id' on 'count' fd's under a single shared lock, and groups the valid ones by provider
+	//
+	// 'errors[i]' is set to 0, or to EBADF if 'fds[i]' is invalid, 'errors' may be nullptr
+	//
+	// the grouping is a counting sort on the provider index, fd's keep their relative order within a group
+	//
+	inline void resolve_many(const int * fds, size_t count, size_t id, SyscallGroups & out, int * errors) {
+		out.slots.resize(count);
+		out.order.resize(count);
+		out.fds.resize(count);
+		out.data.resize(count);
+		out.release();
+		LIBSYSCALL__MUTEX_SHARED_GUARD_VARIABLE
+		size_t providers = provider_table.size();
+		out.offsets.assign(providers + 1, 0);
+		lookup_many(fds, count, out.slots.data());
+		for (size_t i = 0; i < count; i++) {
+			Slot * slot = out.slots[i];
+			if (slot == nullptr || slot->table == nullptr) {
+				LIBSYSCALL__TRACE(SYSCALL_TRACE_CALL, fds[i], SYSCALL_TRACE_NO_PROVIDER, id)
+				out.slots[i] = nullptr;
+				if (errors != nullptr) errors[i] = EBADF;
+				continue;
+			}
+			LIBSYSCALL__TRACE(SYSCALL_TRACE_CALL, fds[i], static_cast<SyscallProvider*>(slot->table)->index, id)
+			LIBSYSCALL__IDLE_TOUCH(slot)
+			if (errors != nullptr) errors[i] = 0;
+			out.offsets[static_cast<SyscallProvider*>(slot->table)->index + 1]++;
+		}
+		for (size_t p = 0; p < providers; p++) {
+			size_t begin = out.offsets[p];
+			size_t end = begin + out.offsets[p + 1];
+			out.offsets[p + 1] = (uint32_t)end;
+			if (begin != end) {
+				SyscallTable * table = provider_table[p].table.load(std::memory_order_relaxed);
+				out.groups.push_back({ begin, end, table->syscalls[id], table->syscalls[batch_id(id)], table->intercepts(id) });
+				if (table->intercepts(id)) table->reference();
+			}
+		}
+		for (size_t i = 0; i < count; i++) {
+			Slot * slot = out.slots[i];
+			if (slot == nullptr) continue;
+			size_t k = out.offsets[static_cast<SyscallProvider*>(slot->table)->index]++;
+			out.order[k] = (uint32_t)i;
+			out.fds[k] = fds[i];
+			out.data[k] = slot->data;
+		}
+	}
+
+protected:
+	[[noreturn]] inline void throw_invalid_fd(int fd) {
 		if (fd == -1) {
 			throw new std::runtime_error("SYSCALL_BASE ERROR: fd is -1");
 		}
-		if (!wl_syscalls__fd_allocator__fd_is_valid(descriptor_list, fd)) {
-			std::string msg = "SYSCALL_BASE ERROR: fd (" + std::to_string(fd) + ") is invalid";
+		std::string msg = "SYSCALL_BASE ERROR: fd (" + std::to_string(fd) + ") is invalid";
+		throw new std::runtime_error(msg.c_str());
+	}
+
+	// deallocates a closing fd once its last pin is gone
+	inline void finish_close(int fd) {
+		LIBSYSCALL__MUTEX_GUARD_VARIABLE
+		for (size_t i = 0; i < closing.size(); i++) {
+			if (closing[i].fd != fd) continue;
+			Slot * slot = lookup(fd);
+			if (slot == nullptr || resource_of(slot)->pins.load(std::memory_order_acquire) != 0) return;
+			// the destroy callback may still make syscalls on 'fd', so it sees its provider again
+			slot->table = closing[i].provider;
+			closing.erase(closing.begin() + i);
+			destroy_fd(fd, false);
+			return;
+		}
+	}
+
+	// the staged entries of 'provider' with the unset ones taken from its parents, see 'set_parent'
+	//
+	// a syscall and its batch entry always come from the same provider, the nearest one that implements the syscall
+	inline std::vector<void*> inherited_entries(SyscallProvider & provider) {
+		std::vector<void*> entries = provider.syscalls;
+		for (size_t id = 0; id < syscall_count; id++) {
+			if (entries[id] != nullptr) continue;
+			for (SyscallProvider * p = provider.parent; p != nullptr; p = p->parent) {
+				if (p->syscalls[id] == nullptr) continue;
+				entries[id] = p->syscalls[id];
+				entries[batch_id(id)] = p->syscalls[batch_id(id)];
+				break;
+			}
+		}
+		return entries;
+	}
+
+	// builds a new table from the staged entries and swaps it in, the replaced table is appended to 'retired'
+	//
+	// the providers that inherit from 'provider' are rebuilt too, see 'set_parent'
+	inline void rebuild_locked(SyscallProvider & provider, std::vector<SyscallTable*> & retired) {
+		SyscallTable * new_table = SyscallTable::create(&provider, ++provider.version, provider.parent == nullptr ? provider.syscalls : inherited_entries(provider));
+		if (!provider.interceptors.empty() || !provider.permitted.empty()) {
+			intercept_locked(provider, new_table);
+		}
+		SyscallTable * old_table = provider.table.exchange(new_table, std::memory_order_seq_cst);
+		if (old_table != nullptr) retired.push_back(old_table);
+		for (SyscallProvider * child : provider.children) {
+			rebuild_locked(*child, retired);
+		}
+	}
+
+	// builds a new table from the staged entries and makes it live, the caller must hold 'mutex' exclusively
+	//
+	// the fd's of a provider reach its table through the provider, so this takes the same time however many fd's it has
+	//
+	// no call can be inside 'resolve' while we hold the mutex exclusively, and the namespaces, which read the tables without it,
+	//  are waited for by the epoch, so after that nothing can observe the replaced tables but the handles that hold a reference
+	inline void publish_locked(SyscallProvider & provider) {
+		std::vector<SyscallTable*> retired;
+		rebuild_locked(provider, retired);
+		if (retired.empty()) return;
+		if (namespaces.load(std::memory_order_seq_cst) != 0) {
+			LIBSYSCALL__EPOCH_SYNCHRONIZE
+		}
+		for (SyscallTable * table : retired) table->release();
+	}
+
+	// replaces the entries of a table that is about to be published with intercepted ones
+	//
+	// syscalls the provider does not implement stay nullptr, and permitted syscalls stay direct if there are no interceptors
+	//
+	// batch entries are dropped, so that 'call_many' runs the interceptors once per fd
+	//
+	inline void intercept_locked(SyscallProvider & provider, SyscallTable * table) {
+		SyscallHooks * block = new SyscallHooks();
+		table->hooks = block;
+		// pre hooks run newest first, post hooks oldest first
+		for (const SyscallInterceptor & c : provider.interceptors) {
+			if (c.pre != nullptr) block->pre.push_back({ c.pre, c.user });
+		}
+		for (size_t i = provider.interceptors.size(); i-- != 0;) {
+			const SyscallInterceptor & c = provider.interceptors[i];
+			if (c.post != nullptr) block->post.push_back({ c.post, c.user });
+		}
+		block->entries.resize(syscall_count);
+		block->intercepted.reset(new bool[syscall_count * 2]());
+		for (size_t id = 0; id < syscall_count; id++) {
+			bool permitted = provider.permitted.empty() || provider.permitted[id];
+			table->syscalls[batch_id(id)] = nullptr;
+			if (table->syscalls[id] == nullptr || (permitted && block->pre.empty() && block->post.empty())) continue;
+			block->entries[id] = { table->syscalls[id], id, permitted ? 0 : EPERM, block->pre.data(), block->pre.size(), block->post.data(), block->post.size(), table };
+			table->syscalls[id] = &block->entries[id];
+			block->intercepted[id] = true;
+		}
+		table->intercepted = block->intercepted.get();
+	}
+
+	// batch entries are stored after the regular ones, see 'batch_id'
+	inline void check_syscall_id(size_t id) {
+		if (id >= syscall_count * 2) {
+			std::string msg = "SYSCALL_BASE ERROR: syscall id (" + std::to_string(id) + ") is out of range";
 			throw new std::runtime_error(msg.c_str());
 		}
-		return *(Resource*)wl_syscalls__fd_allocator__get_value_from_fd(descriptor_list, fd);
 	}
 
 public:
 	inline SyscallProvider& create_provider_entry() {
 		LIBSYSCALL__MUTEX_GUARD_VARIABLE
-		provider_table.emplace_back(SyscallProvider(syscalls));
-		return provider_table.back();
+		provider_table.emplace_back(std::vector<void*>(syscall_count * 2, nullptr), provider_table.size());
+		SyscallProvider & provider = provider_table.back();
+		publish_locked(provider);
+		return provider;
 	}
 
-	inline int allocate_fd(SyscallProvider & provider, void * resource, WL_SYSCALLS_FD_ALLOCATOR_CALLBACK___DESTROY_DATA destroy_callback) {
+	// the provider 'descriptor' defines in this instance, see 'LIBSYSCALL_PROVIDER'
+	//
+	// the first call creates and publishes every static provider of this instance's syscall table that is linked into the program,
+	//  nothing runs before that, so static providers cost nothing at startup and never depend on initialization order
+	//
+	inline SyscallProvider & static_provider(const SyscallStaticProvider & descriptor);
+
+	// atomically replace any number of a provider's syscalls
+	//
+	// calls that have already resolved their syscall finish on the old implementation,
+	//  every call that starts after 'publish' returns sees all of the new entries, never a mix
+	//
+	// this also applies to fd's that were allocated before the update
+	//
+	inline void publish(SyscallProvider & provider, std::initializer_list<SyscallEntry> entries) {
+		LIBSYSCALL__MUTEX_GUARD_VARIABLE
+		for (const SyscallEntry & entry : entries) {
+			check_syscall_id(entry.id);
+		}
+		for (const SyscallEntry & entry : entries) {
+			provider.syscalls[entry.id] = entry.callback;
+		}
+		publish_locked(provider);
+	}
+
+	// layer 'provider' over 'parent', every syscall 'provider' does not implement is served by 'parent' (or its own parent, and so on)
+	//
+	// the inherited entries are copied into the provider's table when it is published, so dispatch is still a single table lookup,
+	//  and publishing a parent publishes every provider that inherits from it, so changes to the parent reach them right away
+	//
+	// the interceptors and permissions of 'provider' apply to the inherited syscalls as well, the parent's own do not
+	//
+	// nullptr - inherit nothing again, throws if either provider belongs to another instance or 'parent' inherits from 'provider' itself
+	//
+	inline void set_parent(SyscallProvider & provider, SyscallProvider * parent) {
+		LIBSYSCALL__MUTEX_GUARD_VARIABLE
+		if (provider.index >= provider_table.size() || &provider_table[provider.index] != &provider) {
+			throw new std::runtime_error("SYSCALL_BASE ERROR: provider belongs to another instance");
+		}
+		if (parent != nullptr) {
+			if (parent->index >= provider_table.size() || &provider_table[parent->index] != parent) {
+				throw new std::runtime_error("SYSCALL_BASE ERROR: parent provider belongs to another instance");
+			}
+			for (SyscallProvider * p = parent; p != nullptr; p = p->parent) {
+				if (p == &provider) throw new std::runtime_error("SYSCALL_BASE ERROR: parent provider inherits from this provider");
+			}
+		}
+		if (provider.parent != nullptr) {
+			std::vector<SyscallProvider*> & siblings = provider.parent->children;
+			siblings.erase(std::find(siblings.begin(), siblings.end(), &provider));
+		}
+		provider.parent = parent;
+		if (parent != nullptr) parent->children.push_back(&provider);
+		publish_locked(provider);
+	}
+
+	// wrap every syscall of 'provider' in 'interceptor'
+	//
+	// interceptors stack, the newest one runs its 'pre' hook first and its 'post' hook last,
+	//  if a 'pre' hook fails the call, no further hooks run and the syscall is not called
+	//
+	// the hooks are compiled into the provider's table, a provider without interceptors or permissions pays nothing for this
+	//
+	inline void add_interceptor(SyscallProvider & provider, const SyscallInterceptor & interceptor) {
+		LIBSYSCALL__MUTEX_GUARD_VARIABLE
+		provider.interceptors.insert(provider.interceptors.begin(), interceptor);
+		publish_locked(provider);
+	}
+
+	inline void remove_interceptor(SyscallProvider & provider, const SyscallInterceptor & interceptor) {
+		LIBSYSCALL__MUTEX_GUARD_VARIABLE
+		for (size_t i = 0; i < provider.interceptors.size(); i++) {
+			const SyscallInterceptor & c = provider.interceptors[i];
+			if (c.pre == interceptor.pre && c.post == interceptor.post && c.user == interceptor.user) {
+				provider.interceptors.erase(provider.interceptors.begin() + i);
+				publish_locked(provider);
+				return;
+			}
+		}
+	}
+
+	// restrict 'provider' to the syscalls flagged in 'permitted' (indexed by syscall id), the others fail with EPERM
+	//
+	// an empty 'permitted' permits everything again, see 'SYSCALLS::permissions' for a type-checked way to build one
+	//
+	inline void set_permissions(SyscallProvider & provider, const std::vector<bool> & permitted) {
 		LIBSYSCALL__MUTEX_GUARD_VARIABLE
-		return wl_syscalls__fd_allocator__allocate_fd(descriptor_list, new Resource(provider, resource), destroy_callback);
+		if (!permitted.empty() && permitted.size() != syscall_count) {
+			std::string msg = "SYSCALL_BASE ERROR: permissions have " + std::to_string(permitted.size()) + " entries, expected " + std::to_string(syscall_count);
+			throw new std::runtime_error(msg.c_str());
+		}
+		provider.permitted = permitted;
+		publish_locked(provider);
+	}
+
+	// a 'resource' made by 'make_resource' of 'provider' is found in its pools, which costs a search while 'provider' has any
+	inline int allocate_fd(SyscallProvider & provider, void * resource, WL_SYSCALLS_FD_ALLOCATOR_CALLBACK___DESTROY_DATA destroy_callback) {
+		return allocate_fd_in(provider, resource, destroy_callback, provider.slabs.owner(resource));
+	}
+
+	// 'allocate_fd' for a 'resource' made by 'make_resource<T>' of 'provider', whose pool is read from its block
+	template <typename T>
+	inline int allocate_fd(SyscallProvider & provider, T * resource, WL_SYSCALLS_FD_ALLOCATOR_CALLBACK___DESTROY_DATA destroy_callback, SyscallPooled) {
+		libsyscall__slab * slab = resource == nullptr ? nullptr : provider.slabs.of_resource(resource);
+		if (resource != nullptr && slab == nullptr) {
+			throw new std::runtime_error("SYSCALL_BASE ERROR: resource was not made by this provider");
+		}
+		return allocate_fd_in(provider, resource, destroy_callback, slab);
 	}
 
+	// if 'fd' is pinned it stops resolving immediately, but is only deallocated once the last pin is released
 	inline void deallocate_fd(SyscallProvider& provider, int fd) {
 		LIBSYSCALL__MUTEX_GUARD_VARIABLE
-		wl_syscalls__fd_allocator__deallocate_fd(descriptor_list, fd);
+		Slot * slot = lookup(fd);
+		if (slot == nullptr || slot->table == nullptr) {
+			return;
+		}
+		LIBSYSCALL__TRACE(SYSCALL_TRACE_DEALLOCATE, fd, static_cast<SyscallProvider*>(slot->table)->index, 0)
+		for (const CloseObserver & observer : close_observers) {
+			observer.callback(observer.user, fd);
+		}
+		if (resource_of(slot)->pins.load(std::memory_order_acquire) != 0) {
+			closing.push_back({ fd, static_cast<SyscallProvider*>(slot->table) });
+			slot->table = nullptr;
+			return;
+		}
+		destroy_fd(fd, false);
+	}
+
+	// see 'transfer_fd' below
+	friend int transfer_fd(SYSCALL_BASE & src, int fd, SYSCALL_BASE & dst, SyscallProvider * provider);
+
+#if LIBSYSCALL_MEMO
+	// cache the results of the syscalls flagged in 'cacheable' (indexed by syscall id) per fd, an empty 'cacheable' caches nothing
+	//
+	// the arguments of a call are not part of the cache key, so a cacheable syscall should not depend on them
+	//
+	// a cached syscall of an fd is only called again once its result has been dropped, by 'invalidate',
+	//  by another result taking its place (every fd keeps LIBSYSCALL_MEMO_ENTRIES of them), or by publishing the provider
+	//
+	// only 'call' and 'try_call' use the cache, and only for results that are trivially copyable and at most LIBSYSCALL_MEMO_SIZE bytes,
+	//  syscalls with interceptors or permissions are never cached, see 'SYSCALLS::permissions' for a type-checked way to build a flag set
+	//
+	inline void set_cacheable(SyscallProvider & provider, const std::vector<bool> & cacheable) {
+		LIBSYSCALL__MUTEX_GUARD_VARIABLE
+		if (!cacheable.empty() && cacheable.size() != syscall_count) {
+			std::string msg = "SYSCALL_BASE ERROR: cacheable flags have " + std::to_string(cacheable.size()) + " entries, expected " + std::to_string(syscall_count);
+			throw new std::runtime_error(msg.c_str());
+		}
+		provider.cacheable = cacheable;
+		publish_locked(provider);
+	}
+
+	// drops every cached result of 'fd', does nothing if 'fd' is not open
+	//
+	// a call that is already running when this is called does not cache its result
+	inline void invalidate(int fd) {
+		LIBSYSCALL__MUTEX_SHARED_GUARD_VARIABLE
+		Slot * slot = lookup(fd);
+		if (slot != nullptr) resource_of(slot)->memo.invalidate((size_t)-1);
+	}
+
+	// drops the cached result of syscall 'id' of 'fd'
+	inline void invalidate(int fd, size_t id) {
+		check_syscall_id(id);
+		LIBSYSCALL__MUTEX_SHARED_GUARD_VARIABLE
+		Slot * slot = lookup(fd);
+		if (slot != nullptr) resource_of(slot)->memo.invalidate(id);
+	}
+#endif
+
+	// true if 'fd' is open
+	inline bool valid(int fd) {
+		LIBSYSCALL__MUTEX_SHARED_GUARD_VARIABLE
+		Slot * slot = lookup(fd);
+		return slot != nullptr && slot->table != nullptr;
+	}
+
+	// true if 'fd' is open on 'provider' with resource 'data'
+	inline bool valid(int fd, const SyscallProvider & provider, const void * data) {
+		LIBSYSCALL__MUTEX_SHARED_GUARD_VARIABLE
+		Slot * slot = lookup(fd);
+		return slot != nullptr && static_cast<SyscallProvider*>(slot->table) == &provider && slot->data == data;
+	}
+
+	// 'callback' is invoked with 'user' whenever an fd is closed, before its destroy callback runs
+	//
+	// observers run while the mutex is held exclusively, so they must not block on anything that may wait for a syscall
+	//
+	inline void add_close_observer(void (*callback)(void * user, int fd), void * user) {
+		LIBSYSCALL__MUTEX_GUARD_VARIABLE
+		close_observers.push_back({ callback, user });
+	}
+
+	inline void remove_close_observer(void (*callback)(void * user, int fd), void * user) {
+		LIBSYSCALL__MUTEX_GUARD_VARIABLE
+		for (size_t i = 0; i < close_observers.size(); i++) {
+			if (close_observers[i].callback == callback && close_observers[i].user == user) {
+				close_observers.erase(close_observers.begin() + i);
+				return;
+			}
+		}
+	}
+
+	// a resolved syscall whose fd is kept alive until 'unpin'
+	struct SyscallPin {
+		Slot * slot;
+		int fd;
+		void * data;
+		void * callback;
+		// see 'resolve'
+		bool intercepted;
+	};
+
+	// resolves syscall 'id' on 'fd' and pins the fd, so that it is not deallocated while the call is in flight
+	//
+	// returns 0 on success, EBADF if 'fd' is invalid, ENOSYS if its provider does not implement 'id' (nothing is pinned then)
+	//
+	// every successful 'pin' must be matched by exactly one 'unpin', which also releases the table of an intercepted entry, see 'resolve'
+	//
+	inline int pin(int fd, size_t id, SyscallPin & out) {
+		LIBSYSCALL__MUTEX_SHARED_GUARD_VARIABLE
+		Slot * slot = lookup(fd);
+		if (slot == nullptr || slot->table == nullptr) {
+			LIBSYSCALL__TRACE(SYSCALL_TRACE_CALL, fd, SYSCALL_TRACE_NO_PROVIDER, id)
+			return EBADF;
+		}
+		SyscallTable * table = table_of(slot);
+		LIBSYSCALL__TRACE(SYSCALL_TRACE_CALL, fd, table->provider_index, id)
+		void * callback = table->syscalls[id];
+		if (callback == nullptr) return ENOSYS;
+		LIBSYSCALL__IDLE_TOUCH(slot)
+		resource_of(slot)->pins.fetch_add(1, std::memory_order_relaxed);
+		out = { slot, fd, slot->data, callback, table->intercepts(id) };
+		if (out.intercepted) table->reference();
+		return 0;
+	}
+
+	// if 'fd' was closed while pinned, the last 'unpin' deallocates it
+	inline void unpin(const SyscallPin & pin) {
+		SyscallEntryReference reference(pin.callback, pin.intercepted);
+		{
+			LIBSYSCALL__MUTEX_SHARED_GUARD_VARIABLE
+			if (resource_of(pin.slot)->pins.fetch_sub(1, std::memory_order_acq_rel) != 1 || pin.slot->table != nullptr) return;
+		}
+		finish_close(pin.fd);
+	}
+
+protected:
+	// 'slab' is the pool 'resource' was made in, or nullptr
+	inline int allocate_fd_in(SyscallProvider & provider, void * resource, WL_SYSCALLS_FD_ALLOCATOR_CALLBACK___DESTROY_DATA destroy_callback, libsyscall__slab * slab) {
+		LIBSYSCALL__MUTEX_GUARD_VARIABLE
+		int fd = descriptor_list.allocate(resource, &provider, destroy_callback, slab);
+		LIBSYSCALL__TRACE(SYSCALL_TRACE_ALLOCATE, fd, provider.index, 0)
+		return fd;
 	}
 
-	inline SYSCALL_BASE() {
-		descriptor_list = wl_syscalls__fd_allocator__create();
-		if (descriptor_list == NULL)
-			throw new std::runtime_error("SYSCALL_BASE() ERROR:       FAILED TO INITIALIZE FD ALLOCATOR");
+	// pins 'fd' for a handle and takes a reference to its table, returns false if 'fd' is invalid, see 'SYSCALLS::handle'
+	inline bool open_handle(int fd, Slot ** slot, SyscallTable ** table) {
+		LIBSYSCALL__MUTEX_SHARED_GUARD_VARIABLE
+		Slot * s = lookup(fd);
+		if (s == nullptr || s->table == nullptr) return false;
+		resource_of(s)->pins.fetch_add(1, std::memory_order_relaxed);
+		*slot = s;
+		*table = table_of(s);
+		(*table)->reference();
+		return true;
+	}
+
+	inline void close_handle(int fd, Slot * slot, SyscallTable * table) {
+		table->release();
+		unpin({ slot, fd, nullptr, nullptr, false });
+	}
+
+	// the table a handle dispatches through, moved to the provider's current table if it has been published since
+	//
+	// this is a single load as long as the provider is not published, the lock is only taken to follow a publish
+	//
+	// an fd that was closed meanwhile no longer has a provider in its slot, it follows the provider it had,
+	//  so that the next call takes the single load again
+	//
+	// '*provider_index' receives the index of the fd's provider if it is not nullptr
+	inline SyscallTable * handle_table(Slot * slot, SyscallTable ** table, size_t * provider_index = nullptr) {
+		SyscallTable * t = *table;
+		if (t->provider->current() != t) {
+			LIBSYSCALL__MUTEX_SHARED_GUARD_VARIABLE
+			SyscallTable * now = slot->table == nullptr ? t->provider->current() : table_of(slot);
+			if (now != t) {
+				now->reference();
+				t->release();
+				*table = t = now;
+			}
+		}
+		if (provider_index != nullptr) *provider_index = t->provider_index;
+		return t;
+	}
+
+public:
+
+#if LIBSYSCALL_STATS
+	// the merged counters of every (provider, syscall) pair called since the last 'stats_reset'
+	inline std::vector<SyscallStatsEntry> stats_snapshot() {
+		return stats.snapshot();
+	}
+
+	inline void stats_reset() {
+		stats.reset();
+	}
+
+	// a 'strace -c' style report of 'stats_snapshot'
+	inline std::string stats_report() {
+		return stats.report();
+	}
+#endif
+
+	// destroy the fd's that are still open when this instance is destroyed on 'threads' threads, 0 - one per hardware thread,
+	//  1 - on the destroying thread only (the default)
+	//
+	// the fd table is split into ranges of fd's and every thread runs the destroy callbacks of a range,
+	//  tables below LIBSYSCALL_TEARDOWN_MIN_FDS fd's per thread use fewer threads
+	//
+	// the callbacks then run concurrently, they may still make syscalls, but must not allocate or deallocate fd's
+	//
+	inline void set_teardown_threads(size_t threads) {
+		LIBSYSCALL__MUTEX_GUARD_VARIABLE
+		teardown_threads = threads;
+	}
+
+#if LIBSYSCALL_IDLE
+	// deallocate 'fd' once it has not been called for 'milliseconds', 0 - never (the default)
+	//
+	// every call on 'fd' ('call', 'try_call', batches, pins) restarts its timeout, an fd is only checked by 'expire_idle',
+	//  which then deallocates it like 'deallocate_fd' would, so its destroy callback runs as usual
+	//
+	// timeouts are rounded up to LIBSYSCALL_IDLE_TICK_MS, calls record the tick of the last 'expire_idle',
+	//  so 'expire_idle' should run at least once per tick for the timeouts to be that precise
+	//
+	// the timeout does not move along with 'transfer_fd'
+	//
+	inline void set_idle_timeout(int fd, uint64_t milliseconds) {
+		LIBSYSCALL__MUTEX_GUARD_VARIABLE
+		Slot * slot = lookup(fd);
+		if (slot == nullptr || slot->table == nullptr) throw_invalid_fd(fd);
+		Resource * resource = resource_of(slot);
+		idle_cancel(resource);
+		resource->idle.timeout = (milliseconds + LIBSYSCALL_IDLE_TICK_MS - 1) / LIBSYSCALL_IDLE_TICK_MS;
+		if (resource->idle.timeout == 0) return;
+		resource->idle.last_used.store(idle.now(), std::memory_order_relaxed);
+		idle_schedule(fd, resource, idle.now() + resource->idle.timeout);
+	}
+
+	// deallocates every fd that has been idle for at least its timeout, returns how many were deallocated
+	//
+	// a pinned fd is never expired, its timeout restarts instead
+	//
+	inline size_t expire_idle() {
+		LIBSYSCALL__MUTEX_GUARD_VARIABLE
+		idle_due.clear();
+		idle.advance(idle.elapsed(), idle_due, [this](int fd) -> libsyscall__idle_node & { return idle_node(fd); });
+		uint64_t now = idle.now();
+		size_t expired = 0;
+		// destroy callbacks may close the other due fd's, or reuse their numbers, so each one is looked up again
+		for (size_t i = 0; i < idle_due.size(); i++) {
+			int fd = idle_due[i];
+			Resource * resource = descriptor_list.get(fd);
+			if (resource == nullptr || resource->idle.level != LIBSYSCALL__IDLE_DUE) continue;
+			resource->idle.level = LIBSYSCALL__IDLE_UNLINKED;
+			if (resource->slot.table == nullptr) continue;
+			uint64_t deadline = resource->idle.last_used.load(std::memory_order_relaxed) + resource->idle.timeout;
+			if (deadline > now) {
+				idle_schedule(fd, resource, deadline);
+				continue;
+			}
+			if (resource->pins.load(std::memory_order_acquire) != 0) {
+				idle_schedule(fd, resource, now + resource->idle.timeout);
+				continue;
+			}
+			deallocate_fd(*static_cast<SyscallProvider*>(resource->slot.table), fd);
+			expired++;
+		}
+		return expired;
+	}
+#endif
+
+#if LIBSYSCALL_TRACE
+	// record every 'allocate_fd', 'deallocate_fd' and syscall into 'trace', replacing the trace that was recorded into before
+	//
+	// calls that fail with EBADF are recorded too, with SYSCALL_TRACE_NO_PROVIDER as their provider
+	//
+	// throws if this instance has more syscalls than a record can tell apart, see SYSCALL_TRACE_MAX_SYSCALLS
+	//
+	inline void trace_start(SyscallTrace & trace) {
+		if (syscall_count > SYSCALL_TRACE_MAX_SYSCALLS) {
+			std::string msg = "SYSCALL_BASE ERROR: " + std::to_string(syscall_count) + " syscalls cannot be traced, at most " + std::to_string(SYSCALL_TRACE_MAX_SYSCALLS) + " can";
+			throw new std::runtime_error(msg.c_str());
+		}
+		LIBSYSCALL__MUTEX_GUARD_VARIABLE
+		tracer.target.store(&trace, std::memory_order_relaxed);
+	}
+
+	// records are only written while the mutex is held, so once this returns the trace may be read
+	inline void trace_stop() {
+		LIBSYSCALL__MUTEX_GUARD_VARIABLE
+		tracer.target.store(nullptr, std::memory_order_relaxed);
+	}
+#endif
+
+	inline SYSCALL_BASE(size_t syscall_count) :
+#if LIBSYSCALL_STATS
+		stats(syscall_count),
+#endif
+		syscall_count(syscall_count)
+	{
 	}
 
 	inline virtual ~SYSCALL_BASE() {
-		size_t objcount = wl_syscalls__fd_allocator__size(descriptor_list);
+		size_t objcount = descriptor_list.size();
 		if (objcount != 0) {
 			printf("~SYSCALL_BASE() WARNING: there are %zu allocated objects still present, they will be destroyed\n", objcount);
 		}
-		wl_syscalls__fd_allocator__destroy(descriptor_list);
+		if (namespaces.load(std::memory_order_acquire) != 0) {
+			printf("~SYSCALL_BASE() WARNING: there are %zu namespaces still using this instance, they must be destroyed first\n", namespaces.load(std::memory_order_acquire));
+		}
+		size_t pins = 0;
+		descriptor_list.for_each([&](int, Resource & resource) { pins += resource.pins.load(std::memory_order_acquire); });
+		if (pins != 0) {
+			printf("~SYSCALL_BASE() WARNING: there are %zu pins still held, asynchronous calls are still in flight\n", pins);
+		}
+		for (Closing & c : closing) {
+			lookup(c.fd)->table = c.provider;
+		}
+		closing.clear();
+		size_t threads = teardown_threads == 0 ? (size_t)std::thread::hardware_concurrency() : teardown_threads;
+		threads = std::min(threads, objcount / LIBSYSCALL_TEARDOWN_MIN_FDS);
+		if (threads > 1) teardown_parallel(threads);
+		// destroy callbacks may close or open other fd's, so this goes on until the table is empty
+		std::vector<int> open;
+		while (descriptor_list.size() != 0) {
+			open.clear();
+			descriptor_list.for_each([&](int fd, Resource &) { open.push_back(fd); });
+			for (int fd : open) {
+				if (lookup(fd) != nullptr) destroy_fd(fd, true);
+			}
+		}
+		for (SyscallProvider & provider : provider_table) {
+			provider.table.load(std::memory_order_relaxed)->release();
+		}
 	}
 };
+
+// moves 'fd' out of 'src' and into 'dst', returns its fd in 'dst'
+//
+// the resource and its destroy callback move along as they are, neither the destroy callback nor anything else is invoked,
+//  except for a resource made by 'make_resource', which is moved into the pool of 'provider' because its own pool dies with 'src',
+//  so its address changes (throws if it is not move constructible),
+//  for 'src' the fd is closed (its close observers run), for 'dst' it is a newly allocated fd
+//
+// 'provider' is the provider of 'dst' the fd is bound to, nullptr - the provider of 'dst' with the same index as the fd's provider in 'src'
+//  (instances that create their providers in the same order have matching indices)
+//
+// both instances must be of the same syscall table type, throws if 'fd' is invalid or pinned (see 'SYSCALL_BASE::pin')
+//
+// both instances are locked exclusively, always in the same (address) order, so concurrent transfers in opposite directions cannot deadlock
+//
+inline int transfer_fd(SYSCALL_BASE & src, int fd, SYSCALL_BASE & dst, SYSCALL_BASE::SyscallProvider * provider = nullptr) {
+	using Slot = SYSCALL_BASE::Slot;
+	using SyscallProvider = SYSCALL_BASE::SyscallProvider;
+	if (&src == &dst) {
+		if (!src.valid(fd)) src.throw_invalid_fd(fd);
+		return fd;
+	}
+#if LIBSYSCALL_THREAD_SAFE
+	bool src_first = std::less<SYSCALL_BASE*>()(&src, &dst);
+	std::lock_guard<libsyscall__recursive_shared_mutex> first_guard(src_first ? src.mutex : dst.mutex);
+	std::lock_guard<libsyscall__recursive_shared_mutex> second_guard(src_first ? dst.mutex : src.mutex);
+#endif
+	// the count still tells apart instances that were not built by 'SYSCALLS'
+	if (src.static_table != dst.static_table || src.syscall_count != dst.syscall_count) {
+		throw new std::runtime_error("transfer_fd ERROR: the instances have different syscall tables");
+	}
+	Slot * slot = src.lookup(fd);
+	if (slot == nullptr || slot->table == nullptr) src.throw_invalid_fd(fd);
+	if (SYSCALL_BASE::resource_of(slot)->pins.load(std::memory_order_acquire) != 0) {
+		std::string msg = "transfer_fd ERROR: fd (" + std::to_string(fd) + ") is pinned by a call in flight";
+		throw new std::runtime_error(msg.c_str());
+	}
+	SyscallProvider * from = static_cast<SyscallProvider*>(slot->table);
+	if (provider == nullptr) {
+		if (from->index >= dst.provider_table.size()) {
+			std::string msg = "transfer_fd ERROR: the destination has no provider with index " + std::to_string(from->index);
+			throw new std::runtime_error(msg.c_str());
+		}
+		provider = &dst.provider_table[from->index];
+	}
+	else if (provider->index >= dst.provider_table.size() || &dst.provider_table[provider->index] != provider) {
+		throw new std::runtime_error("transfer_fd ERROR: the provider does not belong to the destination");
+	}
+	void * data = slot->data;
+	libsyscall__slab * slab = SYSCALL_BASE::resource_of(slot)->slab;
+	if (slab != nullptr && slab->relocate == nullptr) {
+		std::string msg = "transfer_fd ERROR: the resource of fd (" + std::to_string(fd) + ") was made by 'make_resource' and cannot be moved";
+		throw new std::runtime_error(msg.c_str());
+	}
+	// the fd is allocated in 'dst' before it leaves 'src', so that it stays in 'src' if 'dst' is out of fd's
+	WL_SYSCALLS_FD_ALLOCATOR_CALLBACK___DESTROY_DATA destroy_callback = SYSCALL_BASE::resource_of(slot)->callback;
+	int moved = dst.descriptor_list.allocate(data, provider, destroy_callback, nullptr);
+	if (slab != nullptr) {
+		libsyscall__slab * to_slab = &provider->slabs.like(*slab);
+		void * block = to_slab->acquire();
+		try {
+			slab->relocate(data, block);
+		}
+		catch (...) {
+			to_slab->abandon(block);
+			dst.descriptor_list.deallocate(moved);
+			throw;
+		}
+		slab->abandon(data);
+		SYSCALL_BASE::Resource * resource = dst.descriptor_list.get(moved);
+		resource->slot.data = block;
+		resource->slab = to_slab;
+	}
+	LIBSYSCALL__TRACE_ON(src, SYSCALL_TRACE_DEALLOCATE, fd, from->index, 0)
+	for (const SYSCALL_BASE::CloseObserver & observer : src.close_observers) {
+		observer.callback(observer.user, fd);
+	}
+	// the fd leaves 'src' without its destroy callback being invoked
+	LIBSYSCALL__IDLE_CANCEL_ON(src, SYSCALL_BASE::resource_of(slot))
+	src.descriptor_list.deallocate(fd);
+	LIBSYSCALL__TRACE_ON(dst, SYSCALL_TRACE_ALLOCATE, moved, provider->index, 0)
+	return moved;
+}
+
+// calls an intercepted table entry, its hooks and then the implementation, see 'SYSCALL_BASE::add_interceptor'
+//
+// 'F' is the syscall's 'function_type', the result is what 'try_call' would return
+//
+template <typename F>
+struct libsyscall__intercept;
+
+template <typename Ret, typename ... Args>
+struct libsyscall__intercept<Ret(*)(int, void*, Args...)> {
+	static inline SyscallResult<Ret> invoke(void * entry, int fd, void * data, Args ... args) {
+		const SYSCALL_BASE::SyscallIntercepted & e = *static_cast<const SYSCALL_BASE::SyscallIntercepted*>(entry);
+		if (e.error != 0) return SyscallResult<Ret>::failure(e.error);
+		void * arguments[sizeof...(Args) + 1] = { const_cast<void*>(static_cast<const void*>(std::addressof(args)))..., nullptr };
+		for (size_t i = 0; i < e.pre_count; i++) {
+			int error = e.pre[i].hook(e.pre[i].user, fd, data, e.id, arguments);
+			if (error != 0) return SyscallResult<Ret>::failure(error);
+		}
+		Ret (*callback)(int, void*, Args...) = (Ret (*)(int, void*, Args...))e.callback;
+		if constexpr (std::is_void<Ret>::value) {
+			callback(fd, data, std::forward<Args>(args)...);
+			post(e, fd, data, nullptr);
+			return SyscallResult<Ret>();
+		}
+		else {
+			Ret value = callback(fd, data, std::forward<Args>(args)...);
+			post(e, fd, data, std::addressof(value));
+			return SyscallResult<Ret>(std::move(value));
+		}
+	}
+
+	static inline void post(const SYSCALL_BASE::SyscallIntercepted & e, int fd, void * data, void * result) {
+		for (size_t i = 0; i < e.post_count; i++) {
+			e.post[i].hook(e.post[i].user, fd, data, e.id, result);
+		}
+	}
+};
+
+// a syscall table, this is what you extend from
+//
+// struct MY_SYSCALLS : SYSCALLS<SYS_READ, SYS_WRITE> {};
+//
+// every syscall gets a 'constexpr' id, its position in the list
+//
+template <typename ... Syscalls>
+struct SYSCALLS : SYSCALL_BASE {
+	template <typename S>
+	static constexpr bool contains = (std::is_same<S, Syscalls>::value || ...);
+
+	template <typename S>
+	static constexpr size_t id = libsyscall__index_of<S, Syscalls...>::value;
+
+	static constexpr size_t count = sizeof...(Syscalls);
+
+	inline SYSCALLS() : SYSCALL_BASE(sizeof...(Syscalls)) {
+		static_table = &libsyscall__table_tag<libsyscall__syscall_list<Syscalls...>>::tag;
+#if LIBSYSCALL_STATS
+		static const char * const names[] = { libsyscall__type_name<Syscalls>()..., nullptr };
+		stats.names = names;
+#endif
+#if LIBSYSCALL_TRACE
+		static const uint32_t argument_bytes[] = { libsyscall__trace_argument_bytes<Syscalls>()..., 0 };
+		tracer.argument_bytes = argument_bytes;
+#endif
+	}
+
+	// a type-checked syscall assignment for 'publish'
+	//
+	// SYS.publish(provider, { SYS.entry<SYS_READ>(new_read), SYS.entry<SYS_WRITE>(new_write) });
+	//
+	template <typename S>
+	static inline SyscallEntry entry(typename S::function_type callback) {
+		static_assert(contains<S>, "syscall is not part of this syscall table");
+		return { id<S>, (void*)callback };
+	}
+
+	// a type-checked batch implementation assignment for 'publish', see 'call_many'
+	template <typename S>
+	static inline SyscallEntry batch_entry(typename S::batch_function_type callback) {
+		static_assert(contains<S>, "syscall is not part of this syscall table");
+		return { count + id<S>, (void*)callback };
+	}
+
+	// a permission set for 'set_permissions' that permits exactly the syscalls 'S'
+	//
+	// SYS.set_permissions(provider, SYS.permissions<SYS_READ, SYS_CLOSE>());
+	//
+	// any other per syscall flag set ('set_cacheable') is built the same way
+	//
+	template <typename ... S>
+	static inline std::vector<bool> permissions() {
+		static_assert((contains<S> && ...), "syscall is not part of this syscall table");
+		std::vector<bool> permitted(count, false);
+		((permitted[id<S>] = true), ...);
+		return permitted;
+	}
+
+	// assign the implementation of syscall 'S' for the given provider
+	//
+	// 'callback' must match the signature of 'S' exactly, a captureless lambda converts implicitly
+	//
+	// this takes effect immediately, including for fd's that are already allocated, see 'publish'
+	//
+	template <typename S>
+	inline void register_syscall(SyscallProvider & provider, typename S::function_type callback) {
+		publish(provider, { entry<S>(callback) });
+	}
+
+	// assign a batch implementation of syscall 'S' for the given provider, used by 'call_many'
+	//
+	// the regular implementation is still required for 'call' and friends
+	//
+	template <typename S>
+	inline void register_batch(SyscallProvider & provider, typename S::batch_function_type callback) {
+		publish(provider, { batch_entry<S>(callback) });
+	}
+
+	// invoke syscall 'S' on 'count' fd's with the same arguments
+	//
+	// all fd's are resolved under a single lock and grouped by provider,
+	//  a provider with a batch implementation receives its whole group in one call, other providers are called once per fd
+	//
+	// 'results[i]' receives the result for 'fds[i]', pass nullptr for syscalls returning void
+	// 'errors[i]' receives 0, EBADF, ENOSYS or the error of an interceptor (see 'try_call'), 'errors' may be nullptr
+	//
+	// returns the number of fd's the syscall was invoked on
+	//
+	// this allocates its buffers on every call, see the overload that takes them
+	//
+	template <typename S, typename ... Args>
+	inline size_t call_many(const int * fds, size_t count, typename std::conditional<std::is_void<typename S::return_type>::value, std::nullptr_t, typename S::return_type*>::type results, int * errors, Args && ... args) {
+		SyscallGroups resolved;
+		return call_many<S>(resolved, fds, count, results, errors, std::forward<Args>(args)...);
+	}
+
+	// 'call_many' with buffers owned by the caller, which do not allocate once they have grown to the largest 'count'
+	//
+	// a batch implementation writes straight into 'results' if its group is a run of consecutive fd's of the input,
+	//  otherwise into a buffer of 'resolved' that is seeded by moving from 'results', so 'R' needs no default constructor
+	//
+	template <typename S, typename ... Args>
+	inline size_t call_many(SyscallGroups & resolved, const int * fds, size_t count, typename std::conditional<std::is_void<typename S::return_type>::value, std::nullptr_t, typename S::return_type*>::type results, int * errors, Args && ... args) {
+		static_assert(contains<S>, "syscall is not part of this syscall table");
+		using R = typename S::return_type;
+		resolve_many(fds, count, id<S>, resolved, errors);
+		// the tables of the intercepted groups are released by the next 'resolve_many' on 'resolved' or when it goes away
+		size_t invoked = 0;
+		for (const SyscallGroup & group : resolved.groups) {
+			size_t n = group.end - group.begin;
+			if (group.batch != nullptr) {
+				typename S::batch_function_type batch = (typename S::batch_function_type)group.batch;
+				if constexpr (std::is_void<R>::value) {
+					batch(&resolved.fds[group.begin], &resolved.data[group.begin], n, nullptr, args...);
+				}
+				else if (resolved.order[group.end - 1] - resolved.order[group.begin] == n - 1) {
+					// fd's keep their order within a group, so this is a run of consecutive inputs
+					batch(&resolved.fds[group.begin], &resolved.data[group.begin], n, results + resolved.order[group.begin], args...);
+				}
+				else {
+					std::vector<R> & grouped = resolved.template results_of<R>();
+					for (size_t k = group.begin; k < group.end; k++) {
+						grouped.push_back(std::move(results[resolved.order[k]]));
+					}
+					batch(&resolved.fds[group.begin], &resolved.data[group.begin], n, grouped.data(), args...);
+					for (size_t k = 0; k < n; k++) {
+						results[resolved.order[group.begin + k]] = std::move(grouped[k]);
+					}
+					grouped.clear();
+				}
+				invoked += n;
+			}
+			else if (group.intercepted) {
+				for (size_t k = group.begin; k < group.end; k++) {
+					SyscallResult<R> r = libsyscall__intercept<typename S::function_type>::invoke(group.callback, resolved.fds[k], resolved.data[k], args...);
+					if (errors != nullptr) errors[resolved.order[k]] = r.error();
+					if (!r.ok()) continue;
+					if constexpr (!std::is_void<R>::value) results[resolved.order[k]] = std::move(*r);
+					invoked++;
+				}
+			}
+			else if (group.callback != nullptr) {
+				typename S::function_type callback = (typename S::function_type)group.callback;
+				for (size_t k = group.begin; k < group.end; k++) {
+					if constexpr (std::is_void<R>::value) {
+						callback(resolved.fds[k], resolved.data[k], args...);
+					}
+					else {
+						results[resolved.order[k]] = callback(resolved.fds[k], resolved.data[k], args...);
+					}
+				}
+				invoked += n;
+			}
+			else if (errors != nullptr) {
+				for (size_t k = group.begin; k < group.end; k++) {
+					errors[resolved.order[k]] = ENOSYS;
+				}
+			}
+		}
+		return invoked;
+	}
+
+	// invoke syscall 'S' on 'fd'
+	//
+	// throws if 'fd' is invalid, if its provider does not implement 'S', or if the call is rejected (see 'add_interceptor')
+	//
+	template <typename S, typename ... Args>
+	inline typename S::return_type call(int fd, Args && ... args) {
+		static_assert(contains<S>, "syscall is not part of this syscall table");
+		void * data = nullptr;
+		void * entry = nullptr;
+		bool intercepted = false;
+		LIBSYSCALL__STATS_PROVIDER_VARIABLE
+		LIBSYSCALL__MEMO_PROBE_VARIABLE(typename S::return_type)
+		if (!resolve(fd, id<S>, &data, &entry, &intercepted LIBSYSCALL__STATS_PROVIDER_ARGUMENT LIBSYSCALL__MEMO_PROBE_ARGUMENT)) throw_invalid_fd(fd);
+		SyscallEntryReference reference(entry, intercepted);
+		LIBSYSCALL__STATS_SCOPE_VARIABLE(id<S>)
+		LIBSYSCALL__MEMO_RETURN_IF_HIT(typename S::return_type, libsyscall__probe.value())
+		if (intercepted) {
+			SyscallResult<typename S::return_type> r = libsyscall__intercept<typename S::function_type>::invoke(entry, fd, data, std::forward<Args>(args)...);
+			if (!r.ok()) {
+				LIBSYSCALL__STATS_ERROR
+				std::string msg = "SYSCALL_BASE ERROR: syscall was rejected with error " + std::to_string(r.error());
+				throw new std::runtime_error(msg.c_str());
+			}
+			if constexpr (!std::is_void<typename S::return_type>::value) return std::move(*r);
+			else return;
+		}
+		typename S::function_type callback = (typename S::function_type)entry;
+		if (callback != nullptr) {
+			LIBSYSCALL__MEMO_RETURN_STORED(typename S::return_type, fd, callback(fd, data, std::forward<Args>(args)...), value)
+			return callback(fd, data, std::forward<Args>(args)...);
+		}
+		throw new std::runtime_error("callback not supported");
+	}
+
+	// invoke syscall 'S' on 'fd' without throwing
+	//
+	// an invalid fd yields EBADF, a provider that does not implement 'S' yields ENOSYS
+	//
+	// a syscall that is not permitted yields EPERM, and a failing interceptor yields the error it returned
+	//
+	// exceptions thrown by the implementation itself are not caught
+	//
+	template <typename S, typename ... Args>
+	inline SyscallResult<typename S::return_type> try_call(int fd, Args && ... args) {
+		static_assert(contains<S>, "syscall is not part of this syscall table");
+		using R = typename S::return_type;
+		void * data = nullptr;
+		void * entry = nullptr;
+		bool intercepted = false;
+		LIBSYSCALL__STATS_PROVIDER_VARIABLE
+		LIBSYSCALL__MEMO_PROBE_VARIABLE(R)
+		if (!resolve(fd, id<S>, &data, &entry, &intercepted LIBSYSCALL__STATS_PROVIDER_ARGUMENT LIBSYSCALL__MEMO_PROBE_ARGUMENT)) return SyscallResult<R>::failure(EBADF);
+		SyscallEntryReference reference(entry, intercepted);
+		LIBSYSCALL__STATS_SCOPE_VARIABLE(id<S>)
+		LIBSYSCALL__MEMO_RETURN_IF_HIT(R, SyscallResult<R>(libsyscall__probe.value()))
+		if (intercepted) {
+			SyscallResult<R> r = libsyscall__intercept<typename S::function_type>::invoke(entry, fd, data, std::forward<Args>(args)...);
+			if (!r.ok()) {
+				LIBSYSCALL__STATS_ERROR
+			}
+			return r;
+		}
+		typename S::function_type callback = (typename S::function_type)entry;
+		if (callback == nullptr) {
+			LIBSYSCALL__STATS_ERROR
+			return SyscallResult<R>::failure(ENOSYS);
+		}
+		if constexpr (std::is_void<R>::value) {
+			callback(fd, data, std::forward<Args>(args)...);
+			return SyscallResult<R>();
+		}
+		else {
+			LIBSYSCALL__MEMO_RETURN_STORED(R, fd, callback(fd, data, std::forward<Args>(args)...), SyscallResult<R>(value))
+			return SyscallResult<R>(callback(fd, data, std::forward<Args>(args)...));
+		}
+	}
+
+	// an fd that has been resolved once, see 'handle'
+	//
+	// a handle is not thread safe, every thread that calls through it should have its own
+	//
+	struct Handle {
+		SYSCALLS * sys = nullptr;
+		int fd = -1;
+		Slot * slot = nullptr;
+		void * data = nullptr;
+		// the handle holds a reference to it, see 'SYSCALL_BASE::handle_table'
+		SyscallTable * table = nullptr;
+
+		inline Handle() {}
+
+		Handle(const Handle &) = delete;
+		Handle & operator=(const Handle &) = delete;
+
+		inline Handle(Handle && other) noexcept : sys(other.sys), fd(other.fd), slot(other.slot), data(other.data), table(other.table) {
+			other.sys = nullptr;
+		}
+
+		inline Handle & operator=(Handle && other) noexcept {
+			if (this != &other) {
+				reset();
+				sys = other.sys;
+				fd = other.fd;
+				slot = other.slot;
+				data = other.data;
+				table = other.table;
+				other.sys = nullptr;
+			}
+			return *this;
+		}
+
+		inline ~Handle() {
+			reset();
+		}
+
+		inline explicit operator bool() const { return sys != nullptr; }
+
+		// unpins the fd, if it was closed meanwhile and this was its last pin it is deallocated now
+		inline void reset() {
+			if (sys == nullptr) return;
+			SYSCALLS * s = sys;
+			sys = nullptr;
+			s->close_handle(fd, slot, table);
+		}
+
+		// invoke syscall 'S' on the fd, see 'SYSCALLS::call'
+		template <typename S, typename ... Args>
+		inline typename S::return_type call(Args && ... args) {
+			return sys->template call_handle<S>(*this, std::forward<Args>(args)...);
+		}
+
+		// invoke syscall 'S' on the fd without throwing, see 'SYSCALLS::try_call'
+		template <typename S, typename ... Args>
+		inline SyscallResult<typename S::return_type> try_call(Args && ... args) {
+			return sys->template try_call_handle<S>(*this, std::forward<Args>(args)...);
+		}
+	};
+
+	// resolves 'fd' once for repeated calls, throws if 'fd' is invalid
+	//
+	// Handle h = SYS.handle(fd);
+	// h.call<SYS_READ>(buffer, length);
+	//
+	// the fd is pinned for as long as the handle lives, so its resource and slot stay put and a call loads neither,
+	//  a call only checks that the provider has not been published since, and dispatches straight from the cached table
+	//
+	// closing the fd does not affect the handle, the fd stops resolving for everything else, but is only deallocated
+	//  (and its destroy callback run) once the handle is reset or destroyed, like any other pin (see 'pin')
+	//
+	// calls through a handle are counted by stats, but are not traced and do not use result caches
+	//
+	// every handle must be gone before its instance is destroyed
+	//
+	inline Handle handle(int fd) {
+		Handle h;
+		if (!open_handle(fd, &h.slot, &h.table)) throw_invalid_fd(fd);
+		h.sys = this;
+		h.fd = fd;
+		h.data = h.slot->data;
+		return h;
+	}
+
+protected:
+	template <typename S, typename ... Args>
+	inline typename S::return_type call_handle(Handle & h, Args && ... args) {
+		static_assert(contains<S>, "syscall is not part of this syscall table");
+		if (h.sys == nullptr) throw new std::runtime_error("SYSCALL_BASE ERROR: handle is empty");
+		LIBSYSCALL__STATS_PROVIDER_VARIABLE
+		SyscallTable * table = handle_table(h.slot, &h.table LIBSYSCALL__STATS_PROVIDER_ARGUMENT);
+		LIBSYSCALL__STATS_SCOPE_VARIABLE(id<S>)
+		void * entry = table->syscalls[id<S>];
+		if (table->intercepts(id<S>)) {
+			SyscallResult<typename S::return_type> r = libsyscall__intercept<typename S::function_type>::invoke(entry, h.fd, h.data, std::forward<Args>(args)...);
+			if (!r.ok()) {
+				LIBSYSCALL__STATS_ERROR
+				std::string msg = "SYSCALL_BASE ERROR: syscall was rejected with error " + std::to_string(r.error());
+				throw new std::runtime_error(msg.c_str());
+			}
+			if constexpr (!std::is_void<typename S::return_type>::value) return std::move(*r);
+			else return;
+		}
+		typename S::function_type callback = (typename S::function_type)entry;
+		if (callback != nullptr) return callback(h.fd, h.data, std::forward<Args>(args)...);
+		throw new std::runtime_error("callback not supported");
+	}
+
+	template <typename S, typename ... Args>
+	inline SyscallResult<typename S::return_type> try_call_handle(Handle & h, Args && ... args) {
+		static_assert(contains<S>, "syscall is not part of this syscall table");
+		using R = typename S::return_type;
+		if (h.sys == nullptr) return SyscallResult<R>::failure(EBADF);
+		LIBSYSCALL__STATS_PROVIDER_VARIABLE
+		SyscallTable * table = handle_table(h.slot, &h.table LIBSYSCALL__STATS_PROVIDER_ARGUMENT);
+		LIBSYSCALL__STATS_SCOPE_VARIABLE(id<S>)
+		void * entry = table->syscalls[id<S>];
+		if (table->intercepts(id<S>)) {
+			SyscallResult<R> r = libsyscall__intercept<typename S::function_type>::invoke(entry, h.fd, h.data, std::forward<Args>(args)...);
+			if (!r.ok()) {
+				LIBSYSCALL__STATS_ERROR
+			}
+			return r;
+		}
+		typename S::function_type callback = (typename S::function_type)entry;
+		if (callback == nullptr) {
+			LIBSYSCALL__STATS_ERROR
+			return SyscallResult<R>::failure(ENOSYS);
+		}
+		if constexpr (std::is_void<R>::value) {
+			callback(h.fd, h.data, std::forward<Args>(args)...);
+			return SyscallResult<R>();
+		}
+		else {
+			return SyscallResult<R>(callback(h.fd, h.data, std::forward<Args>(args)...));
+		}
+	}
+
+public:
+#if LIBSYSCALL_MEMO
+	using SYSCALL_BASE::invalidate;
+
+	// drops the cached result of syscall 'S' of 'fd', see 'set_cacheable'
+	template <typename S>
+	inline void invalidate(int fd) {
+		static_assert(contains<S>, "syscall is not part of this syscall table");
+		invalidate(fd, id<S>);
+	}
+#endif
+};
+
+// the syscalls of a syscall table type, 'libsyscall__syscalls_of<MY_SYSCALLS>()' is a 'libsyscall__syscall_list<SYS_A, SYS_B, ...>'
+template <typename ... Syscalls>
+struct libsyscall__syscall_list {};
+
+template <typename ... Syscalls>
+libsyscall__syscall_list<Syscalls...> libsyscall__syscall_list_of(SYSCALLS<Syscalls...> *);
+
+template <typename Table>
+inline decltype(libsyscall__syscall_list_of((Table*)nullptr)) libsyscall__syscalls_of() {
+	return {};
+}
+
+// a provider defined at compile time, see 'LIBSYSCALL_PROVIDER'
+//
+// descriptors are constant data placed in a dedicated linker section, they have no constructors and run nothing before 'main'
+struct SyscallStaticProvider {
+	// the 'libsyscall__table_tag' of the syscall table the provider was defined for
+	const void * table;
+	const char * name;
+	void (*publish)(SYSCALL_BASE & sys, SYSCALL_BASE::SyscallProvider & provider);
+};
+
+template <typename S, typename S::function_type F>
+struct libsyscall__static_entry {
+	template <typename Table>
+	static inline SYSCALL_BASE::SyscallEntry make() { return Table::template entry<S>(F); }
+};
+
+template <typename S, typename S::batch_function_type F>
+struct libsyscall__static_batch_entry {
+	template <typename Table>
+	static inline SYSCALL_BASE::SyscallEntry make() { return Table::template batch_entry<S>(F); }
+};
+
+template <typename Table, typename ... Entries>
+struct libsyscall__static_publish {
+	static void publish(SYSCALL_BASE & sys, SYSCALL_BASE::SyscallProvider & provider) {
+		sys.publish(provider, { Entries::template make<Table>()... });
+	}
+};
+
+// the section holds one 'const SyscallStaticProvider *' per 'LIBSYSCALL_PROVIDER', in link order
+#if defined(_MSC_VER)
+// the linker sorts the 'lscprov$x' sections by 'x', the begin and end markers surround the descriptors
+//  and the padding the linker may add between sections reads as nullptr
+#pragma section("lscprov$a", read)
+#pragma section("lscprov$m", read)
+#pragma section("lscprov$z", read)
+#define LIBSYSCALL__PROVIDER_SECTION __declspec(allocate("lscprov$m"))
+extern "C" __declspec(selectany) __declspec(allocate("lscprov$a")) const SyscallStaticProvider * const libsyscall__providers_begin = nullptr;
+extern "C" __declspec(selectany) __declspec(allocate("lscprov$z")) const SyscallStaticProvider * const libsyscall__providers_end = nullptr;
+#define LIBSYSCALL__PROVIDERS_BEGIN (&libsyscall__providers_begin + 1)
+#define LIBSYSCALL__PROVIDERS_END (&libsyscall__providers_end)
+#elif defined(__APPLE__)
+#define LIBSYSCALL__PROVIDER_SECTION __attribute__((used, section("__DATA,__lscproviders")))
+extern const SyscallStaticProvider * const libsyscall__providers_begin[] __asm("section$start$__DATA$__lscproviders");
+extern const SyscallStaticProvider * const libsyscall__providers_end[] __asm("section$end$__DATA$__lscproviders");
+#define LIBSYSCALL__PROVIDERS_BEGIN (libsyscall__providers_begin)
+#define LIBSYSCALL__PROVIDERS_END (libsyscall__providers_end)
+#else
+// the linker defines '__start_' and '__stop_' for every section whose name is a valid identifier,
+//  they are weak so that a program without static providers still links
+#define LIBSYSCALL__PROVIDER_SECTION __attribute__((used, section("libsyscall_providers")))
+extern "C" const SyscallStaticProvider * const __start_libsyscall_providers[] __attribute__((weak, visibility("hidden")));
+extern "C" const SyscallStaticProvider * const __stop_libsyscall_providers[] __attribute__((weak, visibility("hidden")));
+#define LIBSYSCALL__PROVIDERS_BEGIN (__start_libsyscall_providers)
+#define LIBSYSCALL__PROVIDERS_END (__stop_libsyscall_providers)
+#endif
+
+// defines the static provider 'name' of the syscall table 'table', with the given syscalls
+//
+// LIBSYSCALL_PROVIDER(MY_SYSCALLS, PIPE_PROVIDER,
+//     LIBSYSCALL_ENTRY(SYS_READ, pipe_read),
+//     LIBSYSCALL_ENTRY(SYS_WRITE, pipe_write)
+// );
+//
+// int fd = SYS.allocate_fd(SYS.static_provider(PIPE_PROVIDER), pipe, destroy_pipe);
+//
+// other translation units refer to it through 'extern const SyscallStaticProvider PIPE_PROVIDER;'
+//
+#define LIBSYSCALL_PROVIDER(table, name, ...) \
+	extern const SyscallStaticProvider name = { &libsyscall__table_tag<decltype(libsyscall__syscalls_of<table>())>::tag, #name, &libsyscall__static_publish<table, __VA_ARGS__>::publish }; \
+	LIBSYSCALL__PROVIDER_SECTION const SyscallStaticProvider * const libsyscall__static_provider_##name = &name;
+
+// an entry of 'LIBSYSCALL_PROVIDER', 'function' must be a function (not a lambda) with the exact signature of 'S'
+#define LIBSYSCALL_ENTRY(S, function) libsyscall__static_entry<S, &function>
+
+// a batch implementation entry of 'LIBSYSCALL_PROVIDER', see 'SYSCALLS::call_many'
+#define LIBSYSCALL_BATCH_ENTRY(S, function) libsyscall__static_batch_entry<S, &function>
+
+inline SYSCALL_BASE::SyscallProvider & SYSCALL_BASE::static_provider(const SyscallStaticProvider & descriptor) {
+	if (descriptor.table != static_table) {
+		std::string msg = std::string("SYSCALL_BASE ERROR: static provider '") + descriptor.name + "' was defined for a different syscall table";
+		throw new std::runtime_error(msg.c_str());
+	}
+	if (!static_registered.load(std::memory_order_acquire)) {
+		LIBSYSCALL__MUTEX_GUARD_VARIABLE
+		if (!static_registered.load(std::memory_order_relaxed)) {
+			for (const SyscallStaticProvider * const * p = LIBSYSCALL__PROVIDERS_BEGIN; p < LIBSYSCALL__PROVIDERS_END; p++) {
+				if (*p == nullptr || (*p)->table != static_table) continue;
+				SyscallProvider & provider = create_provider_entry();
+				(*p)->publish(*this, provider);
+				static_providers.emplace_back(*p, &provider);
+			}
+			std::sort(static_providers.begin(), static_providers.end(), [](const std::pair<const SyscallStaticProvider*, SyscallProvider*> & a, const std::pair<const SyscallStaticProvider*, SyscallProvider*> & b) {
+				return std::less<const SyscallStaticProvider*>()(a.first, b.first);
+			});
+			static_registered.store(true, std::memory_order_release);
+		}
+	}
+	auto found = std::lower_bound(static_providers.begin(), static_providers.end(), &descriptor, [](const std::pair<const SyscallStaticProvider*, SyscallProvider*> & entry, const SyscallStaticProvider * key) {
+		return std::less<const SyscallStaticProvider*>()(entry.first, key);
+	});
+	if (found == static_providers.end() || found->first != &descriptor) {
+		std::string msg = std::string("SYSCALL_BASE ERROR: static provider '") + descriptor.name + "' is not linked into this program";
+		throw new std::runtime_error(msg.c_str());
+	}
+	return *found->second;
+}
+
+#endif // LIBSYSCALL_H
@@ -0,0 +1,319 @@
+#ifndef LIBSYSCALL_SYSCALL_ASYNC_H
+#define LIBSYSCALL_SYSCALL_ASYNC_H
+
+#include <libsyscall/libsyscall.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <vector>
+#include <tuple>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// asynchronous syscalls, executed on a work-stealing thread pool
+//
+// SyscallThreadPool pool;
+//
+// SyscallFuture<SYS_FLUSH> flush;
+// call_async<SYS_FLUSH>(SYS, pool, flush, fd);
+// ...
+// int r = flush.get();
+//
+// the future is owned by the caller and doubles as the queue entry, so submitting a call never allocates
+//
+// the fd is pinned for the duration of the call, closing it in the meantime is deferred until the call has finished
+//
+
+// a unit of work for SyscallThreadPool, tasks are linked into the worker queues directly
+struct SyscallTask {
+	SyscallTask * next = nullptr;
+	SyscallTask * prev = nullptr;
+	void (*run)(SyscallTask * task) = nullptr;
+};
+
+struct SyscallThreadPoolOptions {
+	// the number of worker threads, 0 - one per hardware thread
+	size_t threads = 0;
+
+	// worker 'i' is bound to cpu 'affinity[i % affinity.size()]', empty - workers are not bound
+	//
+	// only supported on linux, ignored elsewhere
+	std::vector<int> affinity;
+};
+
+// a fixed size pool of workers, each with its own task queue
+//
+// a worker runs the newest task of its own queue first, and steals the oldest task of another worker when it runs dry
+//
+// tasks submitted from a worker go to that worker's queue, tasks submitted from any other thread are spread round robin
+//
+struct SyscallThreadPool {
+	struct Queue {
+		std::mutex mutex;
+		// the oldest task, stolen from here
+		SyscallTask * head = nullptr;
+		// the newest task, the owner pops from here
+		SyscallTask * tail = nullptr;
+
+		inline void push(SyscallTask * task) {
+			std::lock_guard<std::mutex> lock(mutex);
+			task->next = nullptr;
+			task->prev = tail;
+			if (tail != nullptr) tail->next = task;
+			else head = task;
+			tail = task;
+		}
+
+		inline SyscallTask * pop() {
+			std::lock_guard<std::mutex> lock(mutex);
+			SyscallTask * task = tail;
+			if (task == nullptr) return nullptr;
+			tail = task->prev;
+			if (tail != nullptr) tail->next = nullptr;
+			else head = nullptr;
+			return task;
+		}
+
+		inline SyscallTask * steal() {
+			std::lock_guard<std::mutex> lock(mutex);
+			SyscallTask * task = head;
+			if (task == nullptr) return nullptr;
+			head = task->next;
+			if (head != nullptr) head->prev = nullptr;
+			else tail = nullptr;
+			return task;
+		}
+	};
+
+	size_t worker_count;
+	std::unique_ptr<Queue[]> queues;
+	std::vector<std::thread> workers;
+
+	// tasks sitting in a queue, not counting the ones being run
+	std::atomic<size_t> queued = { 0 };
+	std::atomic<size_t> next_queue = { 0 };
+
+	std::mutex sleep_mutex;
+	std::condition_variable sleep_condition;
+	std::atomic<size_t> sleeping = { 0 };
+	bool stopping = false;
+
+	// the pool and queue index of the calling thread, if it is a worker
+	struct Worker {
+		SyscallThreadPool * pool = nullptr;
+		size_t index = 0;
+	};
+
+	static inline Worker & current_worker() {
+		static thread_local Worker worker;
+		return worker;
+	}
+
+	inline SyscallThreadPool(const SyscallThreadPoolOptions & options = SyscallThreadPoolOptions()) {
+		worker_count = options.threads;
+		if (worker_count == 0) worker_count = std::thread::hardware_concurrency();
+		if (worker_count == 0) worker_count = 1;
+		queues.reset(new Queue[worker_count]);
+		workers.reserve(worker_count);
+		for (size_t i = 0; i < worker_count; i++) {
+			workers.emplace_back([this, i] { worker_main(i); });
+#if defined(__linux__)
+			if (!options.affinity.empty()) {
+				cpu_set_t set;
+				CPU_ZERO(&set);
+				CPU_SET(options.affinity[i % options.affinity.size()], &set);
+				pthread_setaffinity_np(workers.back().native_handle(), sizeof(set), &set);
+			}
+#endif
+		}
+	}
+
+	SyscallThreadPool(const SyscallThreadPool &) = delete;
+	SyscallThreadPool & operator=(const SyscallThreadPool &) = delete;
+
+	// runs every task that is still queued, then joins the workers
+	inline ~SyscallThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(sleep_mutex);
+			stopping = true;
+		}
+		sleep_condition.notify_all();
+		for (std::thread & worker : workers) {
+			worker.join();
+		}
+	}
+
+	inline size_t size() const { return worker_count; }
+
+	// queue 'task', it must stay alive and must not be resubmitted until it has run
+	inline void submit(SyscallTask * task) {
+		Worker & worker = current_worker();
+		size_t index = worker.pool == this ? worker.index : next_queue.fetch_add(1, std::memory_order_relaxed) % worker_count;
+		queues[index].push(task);
+		queued.fetch_add(1, std::memory_order_seq_cst);
+		if (sleeping.load(std::memory_order_seq_cst) != 0) {
+			std::lock_guard<std::mutex> lock(sleep_mutex);
+			sleep_condition.notify_one();
+		}
+	}
+
+private:
+	inline SyscallTask * find_task(size_t self) {
+		SyscallTask * task = queues[self].pop();
+		for (size_t i = 1; task == nullptr && i < worker_count; i++) {
+			task = queues[(self + i) % worker_count].steal();
+		}
+		if (task != nullptr) queued.fetch_sub(1, std::memory_order_relaxed);
+		return task;
+	}
+
+	inline void worker_main(size_t self) {
+		current_worker() = { this, self };
+		for (;;) {
+			SyscallTask * task = find_task(self);
+			if (task != nullptr) {
+				task->run(task);
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(sleep_mutex);
+			sleeping.fetch_add(1, std::memory_order_seq_cst);
+			sleep_condition.wait(lock, [this] { return queued.load(std::memory_order_seq_cst) != 0 || stopping; });
+			sleeping.fetch_sub(1, std::memory_order_relaxed);
+			if (stopping && queued.load(std::memory_order_relaxed) == 0) return;
+		}
+	}
+};
+
+// the pending result of an asynchronous syscall
+//
+// either wait for it with 'wait' / 'get', or set 'on_complete' before submitting to be called back instead
+//
+// a future may be reused once it has completed, but must not be moved or destroyed while it is pending
+//
+template <typename S>
+struct SyscallFuture : SyscallTask {
+	using return_type = typename S::return_type;
+
+	// invoked on the thread that completed the call, 'wait' must not be used together with a completion callback
+	//
+	// the callback may resubmit or destroy the future, nothing touches it afterwards
+	void (*on_complete)(SyscallFuture & future, void * user) = nullptr;
+	void * user = nullptr;
+
+	inline SyscallFuture() {}
+	inline SyscallFuture(void (*on_complete)(SyscallFuture &, void *), void * user) : on_complete(on_complete), user(user) {}
+
+	SyscallFuture(const SyscallFuture &) = delete;
+	SyscallFuture & operator=(const SyscallFuture &) = delete;
+
+	// both take the mutex, so that once they report completion the completing thread no longer touches the future
+	inline bool ready() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return done.load(std::memory_order_acquire);
+	}
+
+	inline void wait() {
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock, [this] { return done.load(std::memory_order_acquire); });
+	}
+
+	// waits, then returns the result like 'try_call' would
+	//
+	// an exception thrown by the implementation is rethrown here
+	//
+	inline SyscallResult<return_type> & result() {
+		wait();
+		if (exception) std::rethrow_exception(exception);
+		return *value;
+	}
+
+	// waits, then returns the result like 'call' would
+	inline return_type get() {
+		SyscallResult<return_type> & r = result();
+		if (r.error() == EBADF) throw new std::runtime_error("SYSCALL_BASE ERROR: fd is invalid");
+		if (r.error() == ENOSYS) throw new std::runtime_error("callback not supported");
+		if (!r.ok()) {
+			std::string msg = "SYSCALL_BASE ERROR: syscall was rejected with error " + std::to_string(r.error());
+			throw new std::runtime_error(msg.c_str());
+		}
+		if constexpr (!std::is_void<return_type>::value) return *r;
+	}
+
+	// internal state, set up by 'call_async'
+	SYSCALL_BASE * sys = nullptr;
+	SYSCALL_BASE::SyscallPin pin;
+	std::optional<typename S::argument_tuple> arguments;
+	std::optional<SyscallResult<return_type>> value;
+	std::exception_ptr exception;
+	std::atomic<bool> done = { true };
+	std::mutex mutex;
+	std::condition_variable condition;
+
+	inline void start() {
+		done.store(false, std::memory_order_relaxed);
+		exception = nullptr;
+		value.reset();
+	}
+
+	inline void complete() {
+		if (on_complete != nullptr) {
+			done.store(true, std::memory_order_release);
+			on_complete(*this, user);
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		done.store(true, std::memory_order_release);
+		condition.notify_all();
+	}
+
+	static inline void execute(SyscallTask * task) {
+		SyscallFuture & future = *static_cast<SyscallFuture*>(task);
+		typename S::function_type callback = (typename S::function_type)future.pin.callback;
+		try {
+			if (future.pin.intercepted) {
+				future.value.emplace(std::apply([&](auto & ... args) { return libsyscall__intercept<typename S::function_type>::invoke(future.pin.callback, future.pin.fd, future.pin.data, args...); }, *future.arguments));
+			}
+			else if constexpr (std::is_void<return_type>::value) {
+				std::apply([&](auto & ... args) { callback(future.pin.fd, future.pin.data, args...); }, *future.arguments);
+				future.value.emplace();
+			}
+			else {
+				future.value.emplace(std::apply([&](auto & ... args) { return callback(future.pin.fd, future.pin.data, args...); }, *future.arguments));
+			}
+		}
+		catch (...) {
+			future.exception = std::current_exception();
+		}
+		future.sys->unpin(future.pin);
+		future.complete();
+	}
+};
+
+// invoke syscall 'S' on 'fd' on one of the pool's workers, the result is delivered through 'future'
+//
+// the arguments are copied into the future, reference arguments refer to those copies
+//
+// an invalid fd or an unimplemented syscall completes 'future' immediately, with EBADF or ENOSYS
+//
+template <typename S, typename Table, typename ... Args>
+inline void call_async(Table & sys, SyscallThreadPool & pool, SyscallFuture<S> & future, int fd, Args && ... args) {
+	static_assert(Table::template contains<S>, "syscall is not part of this syscall table");
+	future.start();
+	int error = sys.pin(fd, Table::template id<S>, future.pin);
+	if (error != 0) {
+		future.value = SyscallResult<typename S::return_type>::failure(error);
+		future.complete();
+		return;
+	}
+	future.sys = &sys;
+	future.arguments.emplace(std::forward<Args>(args)...);
+	future.run = &SyscallFuture<S>::execute;
+	pool.submit(&future);
+}
+
+#endif // LIBSYSCALL_SYSCALL_ASYNC_H
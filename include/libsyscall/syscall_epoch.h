@@ -0,0 +1,81 @@
+#ifndef LIBSYSCALL_SYSCALL_EPOCH_H
+#define LIBSYSCALL_SYSCALL_EPOCH_H
+
+// read-side sections for readers of a SYSCALL_BASE's tables that do not hold its mutex, see libsyscall/syscall_namespace.h
+//
+// this is included by libsyscall.h when LIBSYSCALL_THREAD_SAFE is 1, and is not meant to be included directly
+//
+// a reader loads a provider's table and the entry it needs inside a section, 'publish' replaces the table,
+//  and calls 'synchronize' before it drops the old one, which waits for the sections that may still be reading it
+//
+// sections never block, so they can be entered while holding any lock, which is what keeps a namespace's lock out of the registry's
+//
+// readers count themselves in one of two counters of a shard, picked by the phase, and every thread sticks to one shard
+//  so that threads rarely write the same cache line, 'synchronize' flips the phase and waits for the counters it left to drain,
+//  twice, so that a reader that picked its counter right before a flip is waited for by the second round
+//
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <cstddef>
+
+// the number of reader shards of every SYSCALL_BASE, a cache line each
+#ifndef LIBSYSCALL_EPOCH_SHARDS
+#define LIBSYSCALL_EPOCH_SHARDS 16
+#endif
+
+struct libsyscall__epoch {
+	struct alignas(64) Shard {
+		std::atomic<size_t> readers[2] = {};
+	};
+	Shard shards[LIBSYSCALL_EPOCH_SHARDS];
+	std::atomic<size_t> phase = { 0 };
+	// one 'synchronize' at a time, so that the phase is not flipped under another one's wait
+	std::mutex writers;
+
+	static inline size_t shard_of_thread() {
+		static std::atomic<size_t> threads = { 0 };
+		thread_local size_t shard = threads.fetch_add(1, std::memory_order_relaxed) % LIBSYSCALL_EPOCH_SHARDS;
+		return shard;
+	}
+
+	// returns what 'exit' needs
+	//
+	// what 'synchronize' protects must be loaded with 'memory_order_seq_cst' inside the section,
+	//  so that a reader that is counted too late to be waited for also sees the store that was made before 'synchronize'
+	inline size_t enter() {
+		size_t shard = shard_of_thread();
+		size_t parity = phase.load(std::memory_order_seq_cst) & 1;
+		shards[shard].readers[parity].fetch_add(1, std::memory_order_seq_cst);
+		return shard * 2 + parity;
+	}
+
+	inline void exit(size_t token) {
+		shards[token / 2].readers[token & 1].fetch_sub(1, std::memory_order_release);
+	}
+
+	// waits until every section that was entered before this was called has been exited, must not be called inside a section
+	inline void synchronize() {
+		std::lock_guard<std::mutex> guard(writers);
+		for (int round = 0; round < 2; round++) {
+			size_t parity = phase.fetch_add(1, std::memory_order_seq_cst) & 1;
+			for (Shard & shard : shards) {
+				while (shard.readers[parity].load(std::memory_order_seq_cst) != 0) std::this_thread::yield();
+			}
+		}
+	}
+};
+
+struct libsyscall__epoch_guard {
+	libsyscall__epoch & epoch;
+	size_t token;
+
+	inline libsyscall__epoch_guard(libsyscall__epoch & epoch) : epoch(epoch), token(epoch.enter()) {}
+	inline ~libsyscall__epoch_guard() { epoch.exit(token); }
+
+	libsyscall__epoch_guard(const libsyscall__epoch_guard &) = delete;
+	libsyscall__epoch_guard & operator=(const libsyscall__epoch_guard &) = delete;
+};
+
+#endif // LIBSYSCALL_SYSCALL_EPOCH_H
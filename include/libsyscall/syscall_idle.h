@@ -0,0 +1,209 @@
+#ifndef LIBSYSCALL_SYSCALL_IDLE_H
+#define LIBSYSCALL_SYSCALL_IDLE_H
+
+// idle fd expiry, see 'SYSCALL_BASE::set_idle_timeout'
+//
+// this is included by libsyscall.h when LIBSYSCALL_IDLE is 1, and is not meant to be included directly
+//
+// time is counted in ticks of LIBSYSCALL_IDLE_TICK_MS, every fd with a timeout has a timer in a hierarchical timing wheel,
+//  LIBSYSCALL_IDLE_LEVELS levels of 64 slots, level 'l' holds the timers due within 64^(l+1) ticks
+//
+// a call only stores the current tick into its fd's node (and only when that tick differs from the stored one),
+//  the timer itself is not touched, when it fires the node is checked and the timer is moved to the refreshed deadline,
+//  so inserting, moving and cancelling a timer are all O(1), and a busy fd costs one wheel operation per timeout at most
+//
+// the nodes live inside the fd table entries and link fd's, so the wheel allocates nothing of its own
+//
+// every level keeps a bitmap of its non-empty slots, so advancing the wheel jumps from one tick that has work to the next,
+//  and costs O(levels) per such tick rather than one step per tick that passed
+//
+
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// the length of a tick, the resolution of idle timeouts
+#ifndef LIBSYSCALL_IDLE_TICK_MS
+#define LIBSYSCALL_IDLE_TICK_MS 100
+#endif
+
+// timers further out than 64^LIBSYSCALL_IDLE_LEVELS ticks are parked in the last level and re-checked every time they come up
+#ifndef LIBSYSCALL_IDLE_LEVELS
+#define LIBSYSCALL_IDLE_LEVELS 4
+#endif
+
+#define LIBSYSCALL__IDLE_UNLINKED -1
+// popped by 'advance', and not yet handled by its caller
+#define LIBSYSCALL__IDLE_DUE -2
+
+// the timer of one fd
+struct libsyscall__idle_node {
+	// the tick of the last call, the only field written outside the exclusive lock
+	std::atomic<uint64_t> last_used = { 0 };
+	// in ticks, 0 - no timeout
+	uint64_t timeout = 0;
+	// the tick the timer fires at
+	uint64_t deadline = 0;
+	int prev = -1;
+	int next = -1;
+	// the level the timer is linked into, LIBSYSCALL__IDLE_UNLINKED or LIBSYSCALL__IDLE_DUE if none
+	int level = LIBSYSCALL__IDLE_UNLINKED;
+	int slot = 0;
+};
+
+// the index of the lowest set bit of 'bits', which must not be 0
+inline int libsyscall__idle_lowest_bit(uint64_t bits) {
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return (int)index;
+#else
+	return __builtin_ctzll(bits);
+#endif
+}
+
+struct libsyscall__idle_wheel {
+	static constexpr int slots = 64;
+	static constexpr int levels = LIBSYSCALL_IDLE_LEVELS;
+
+	// the current tick, calls copy it into their node
+	std::atomic<uint64_t> clock = { 0 };
+	// the first fd of every slot
+	int heads[levels][slots];
+	// bit 's' of level 'l' is set while 'heads[l][s]' is not empty
+	uint64_t occupied[levels] = {};
+	// the number of linked timers
+	size_t count = 0;
+	std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+
+	inline libsyscall__idle_wheel() {
+		for (int l = 0; l < levels; l++) {
+			for (int s = 0; s < slots; s++) heads[l][s] = -1;
+		}
+	}
+
+	inline uint64_t now() const { return clock.load(std::memory_order_relaxed); }
+
+	// the tick of the steady clock
+	inline uint64_t elapsed() const {
+		return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - origin).count() / LIBSYSCALL_IDLE_TICK_MS;
+	}
+
+	// the hot path, stores the current tick into 'node' if it has a timeout
+	static inline void touch(libsyscall__idle_node & node, uint64_t now) {
+		if (node.timeout != 0 && node.last_used.load(std::memory_order_relaxed) != now) {
+			node.last_used.store(now, std::memory_order_relaxed);
+		}
+	}
+
+	// links the timer of 'fd' into the slot of 'node.deadline', which must not be in the past
+	//
+	// 'node_of(fd)' returns the node of an fd
+	template <typename NodeOf>
+	inline void insert(int fd, libsyscall__idle_node & node, NodeOf && node_of) {
+		uint64_t t = now();
+		uint64_t delta = node.deadline - t;
+		uint64_t due = node.deadline;
+		int level = 0;
+		while (level < levels - 1 && delta >= ((uint64_t)1 << (6 * (level + 1)))) level++;
+		if (level == levels - 1 && delta >= ((uint64_t)1 << (6 * levels))) {
+			// parked, see LIBSYSCALL_IDLE_LEVELS
+			due = t + ((uint64_t)1 << (6 * levels)) - 1;
+		}
+		int slot = (int)((due >> (6 * level)) & (slots - 1));
+		node.level = level;
+		node.slot = slot;
+		node.prev = -1;
+		node.next = heads[level][slot];
+		if (node.next != -1) node_of(node.next).prev = fd;
+		heads[level][slot] = fd;
+		occupied[level] |= (uint64_t)1 << slot;
+		count++;
+	}
+
+	// unlinks the timer of a node, does nothing if it is not linked
+	template <typename NodeOf>
+	inline void cancel(libsyscall__idle_node & node, NodeOf && node_of) {
+		if (node.level < 0) {
+			node.level = LIBSYSCALL__IDLE_UNLINKED;
+			return;
+		}
+		if (node.prev != -1) node_of(node.prev).next = node.next;
+		else heads[node.level][node.slot] = node.next;
+		if (node.next != -1) node_of(node.next).prev = node.prev;
+		if (heads[node.level][node.slot] == -1) occupied[node.level] &= ~((uint64_t)1 << node.slot);
+		node.level = LIBSYSCALL__IDLE_UNLINKED;
+		count--;
+	}
+
+	// how many slots after 'slot' the first non-empty slot of 'level' is, wrapping around, 'slots' if the level is empty
+	inline int distance(int level, int slot) const {
+		uint64_t bits = occupied[level];
+		if (bits == 0) return slots;
+		uint64_t rotated = slot == 0 ? bits : (bits >> slot) | (bits << (slots - slot));
+		return libsyscall__idle_lowest_bit(rotated);
+	}
+
+	// the first tick after 't' that fires a level 0 slot or cascades a non-empty slot of a higher level, UINT64_MAX if there is none
+	inline uint64_t next_event(uint64_t t) const {
+		uint64_t next = UINT64_MAX;
+		int d = distance(0, (int)((t + 1) & (slots - 1)));
+		if (d < slots) next = t + 1 + (uint64_t)d;
+		for (int l = 1; l < levels; l++) {
+			if (occupied[l] == 0) continue;
+			// level 'l' is only looked at on multiples of 'span', one slot each
+			uint64_t span = (uint64_t)1 << (6 * l);
+			uint64_t boundary = ((t >> (6 * l)) + 1) << (6 * l);
+			uint64_t at = boundary + (uint64_t)distance(l, (int)((boundary >> (6 * l)) & (slots - 1))) * span;
+			if (at < next) next = at;
+		}
+		return next;
+	}
+
+	// advances the wheel to tick 'to' and appends the fd's whose timers fired to 'due', their nodes are left LIBSYSCALL__IDLE_DUE
+	//
+	// nothing but the wheel itself is touched, the caller decides what happens to the fired fd's
+	//
+	// the ticks in between that have nothing to do are skipped, see 'next_event'
+	template <typename NodeOf>
+	inline void advance(uint64_t to, std::vector<int> & due, NodeOf && node_of) {
+		uint64_t t = now();
+		while (t < to) {
+			uint64_t next = next_event(t);
+			if (next > to) {
+				t = to;
+				break;
+			}
+			t = next;
+			clock.store(t, std::memory_order_relaxed);
+			// the higher levels first, so that a timer cascades all the way down within the same tick
+			for (int l = levels - 1; l > 0; l--) {
+				if ((t & (((uint64_t)1 << (6 * l)) - 1)) != 0) continue;
+				int slot = (int)((t >> (6 * l)) & (slots - 1));
+				while (heads[l][slot] != -1) {
+					int fd = heads[l][slot];
+					libsyscall__idle_node & node = node_of(fd);
+					cancel(node, node_of);
+					insert(fd, node, node_of);
+				}
+			}
+			int slot = (int)(t & (slots - 1));
+			while (heads[0][slot] != -1) {
+				int fd = heads[0][slot];
+				libsyscall__idle_node & node = node_of(fd);
+				cancel(node, node_of);
+				node.level = LIBSYSCALL__IDLE_DUE;
+				due.push_back(fd);
+			}
+		}
+		clock.store(t, std::memory_order_relaxed);
+	}
+};
+
+#endif // LIBSYSCALL_SYSCALL_IDLE_H
@@ -0,0 +1,173 @@
+#ifndef LIBSYSCALL_SYSCALL_MEMO_H
+#define LIBSYSCALL_SYSCALL_MEMO_H
+
+// per fd result caches, see 'SYSCALL_BASE::set_cacheable'
+//
+// this is included by libsyscall.h when LIBSYSCALL_MEMO is 1, and is not meant to be included directly
+//
+// every fd holds LIBSYSCALL_MEMO_ENTRIES results of its cacheable syscalls, each keyed by syscall id and table version,
+//  so publishing the provider makes every cached result of its fd's miss without touching them
+//
+// the cache is a seqlock, calls read it under the shared lock of their 'SYSCALL_BASE' without writing anything,
+//  a result is only stored if nothing was stored or invalidated since the call looked it up,
+//  and every new cache starts at a sequence no other cache has used, so a result never lands in a reused fd
+//
+
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+// the number of results an fd keeps, the oldest is replaced once they are all taken
+#ifndef LIBSYSCALL_MEMO_ENTRIES
+#define LIBSYSCALL_MEMO_ENTRIES 2
+#endif
+
+// the largest result that is cached, results must also be trivially copyable
+#ifndef LIBSYSCALL_MEMO_SIZE
+#define LIBSYSCALL_MEMO_SIZE 16
+#endif
+
+// true if results of type 'R' can be cached
+//
+// 'size' is the size of a result that can be cached, 0 otherwise
+template <typename R, typename = void>
+struct libsyscall__memoizable : std::false_type {
+	static constexpr size_t size = 0;
+};
+
+template <typename R>
+struct libsyscall__memoizable<R, typename std::enable_if<!std::is_void<R>::value>::type>
+	: std::integral_constant<bool, std::is_trivially_copyable<R>::value && sizeof(R) <= LIBSYSCALL_MEMO_SIZE && alignof(R) <= 16> {
+	static constexpr size_t size = libsyscall__memoizable::value ? sizeof(R) : 0;
+};
+
+struct libsyscall__memo {
+	static constexpr size_t words = (LIBSYSCALL_MEMO_SIZE + 7) / 8;
+
+	struct Entry {
+		// 0 - empty, see 'key_of'
+		std::atomic<uint64_t> key = { 0 };
+		std::atomic<uint64_t> value[words] = {};
+	};
+
+	// odd while a result is being stored
+	std::atomic<uint64_t> sequence;
+	// the entry that is replaced next
+	std::atomic<uint32_t> victim = { 0 };
+	Entry entries[LIBSYSCALL_MEMO_ENTRIES];
+
+	inline libsyscall__memo() : sequence(next_sequence()) {}
+
+	static inline uint64_t next_sequence() {
+		// caches start far apart, a cache would need 2^32 stores to reach the sequence of the next one
+		static std::atomic<uint64_t> sequences = { 0 };
+		return sequences.fetch_add((uint64_t)1 << 32, std::memory_order_relaxed);
+	}
+
+	// syscall ids are far below 2^16
+	static inline uint64_t key_of(size_t id, uint64_t version) {
+		return (version << 16) | (uint64_t)(id + 1);
+	}
+
+	// copies the result cached under 'key' to 'result', returns false if there is none
+	//
+	// '*sequence' receives what 'store' needs to store a result for this lookup, 1 if it cannot
+	inline bool find(uint64_t key, void * result, size_t size, uint64_t * sequence) {
+		uint64_t s = this->sequence.load(std::memory_order_acquire);
+		*sequence = s;
+		if (s & 1) return false;
+		uint64_t copy[words];
+		bool found = false;
+		for (Entry & e : entries) {
+			if (e.key.load(std::memory_order_relaxed) != key) continue;
+			for (size_t i = 0; i < words; i++) copy[i] = e.value[i].load(std::memory_order_relaxed);
+			found = true;
+			break;
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (this->sequence.load(std::memory_order_relaxed) != s) {
+			*sequence = 1;
+			return false;
+		}
+		if (found) memcpy(result, copy, size);
+		return found;
+	}
+
+	// caches 'result' under 'key', unless something was stored or invalidated since the 'find' that returned 'sequence'
+	inline void store(uint64_t key, const void * result, size_t size, uint64_t sequence) {
+		if (sequence & 1) return;
+		if (!this->sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_acquire, std::memory_order_relaxed)) return;
+		// readers must see the odd sequence before any of the entries change
+		std::atomic_thread_fence(std::memory_order_release);
+		uint64_t copy[words] = {};
+		memcpy(copy, result, size);
+		// a stale result of the same syscall (from an older table version) is replaced first
+		size_t id = (size_t)(key & 0xffff);
+		Entry * target = nullptr;
+		for (Entry & e : entries) {
+			uint64_t k = e.key.load(std::memory_order_relaxed);
+			if (k == 0 || (size_t)(k & 0xffff) == id) {
+				target = &e;
+				break;
+			}
+		}
+		if (target == nullptr) {
+			uint32_t v = victim.load(std::memory_order_relaxed);
+			victim.store((v + 1) % LIBSYSCALL_MEMO_ENTRIES, std::memory_order_relaxed);
+			target = &entries[v];
+		}
+		target->key.store(key, std::memory_order_relaxed);
+		for (size_t i = 0; i < words; i++) target->value[i].store(copy[i], std::memory_order_relaxed);
+		this->sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	// drops the result of syscall 'id', or every result if 'id' is (size_t)-1
+	//
+	// waits for a concurrent 'store' to finish, and makes every 'store' of a lookup before it fail
+	inline void invalidate(size_t id) {
+		uint64_t s = sequence.load(std::memory_order_relaxed);
+		for (;;) {
+			if ((s & 1) == 0 && sequence.compare_exchange_weak(s, s + 1, std::memory_order_acquire, std::memory_order_relaxed)) break;
+			s = sequence.load(std::memory_order_relaxed);
+		}
+		std::atomic_thread_fence(std::memory_order_release);
+		for (Entry & e : entries) {
+			uint64_t k = e.key.load(std::memory_order_relaxed);
+			if (id == (size_t)-1 || (k != 0 && (size_t)(k & 0xffff) == id + 1)) e.key.store(0, std::memory_order_relaxed);
+		}
+		sequence.store(s + 2, std::memory_order_release);
+	}
+};
+
+// a lookup of one call, see 'SYSCALL_BASE::resolve'
+struct libsyscall__memo_probe {
+	// 0 - the result type can not be cached, the call does not look
+	size_t size = 0;
+	void * result = nullptr;
+	// set by 'resolve'
+	bool hit = false;
+	// set by 'resolve' on a miss of a cacheable syscall, the call should store its result
+	bool store = false;
+	uint64_t key = 0;
+	uint64_t sequence = 1;
+};
+
+// a probe with room for a result of type 'R'
+template <typename R>
+struct libsyscall__memo_result : libsyscall__memo_probe {
+	alignas(16) unsigned char storage[libsyscall__memoizable<R>::size == 0 ? 1 : libsyscall__memoizable<R>::size];
+
+	inline libsyscall__memo_result() {
+		size = libsyscall__memoizable<R>::size;
+		result = storage;
+	}
+
+	inline R value() const {
+		return *std::launder(reinterpret_cast<const R*>(storage));
+	}
+};
+
+#endif // LIBSYSCALL_SYSCALL_MEMO_H
@@ -0,0 +1,178 @@
+#ifndef LIBSYSCALL_SYSCALL_NAMESPACE_H
+#define LIBSYSCALL_SYSCALL_NAMESPACE_H
+
+#include <libsyscall/libsyscall.h>
+
+// an fd namespace that shares the providers of a syscall table instance
+//
+// MY_SYSCALLS registry;                            // owns the providers, their tables, pools and interceptors
+// auto & provider = registry.create_provider_entry();
+// SyscallNamespace<MY_SYSCALLS> tenant(registry);  // numbers its own fd's, starting at 0
+// int fd = tenant.allocate_fd(provider, resource, destroy_callback);
+// tenant.call<SYS_READ>(fd, buffer, size);
+//
+// a namespace holds nothing but its fd table and a mutex of its own, an empty one is about 500 bytes,
+//  so a process can keep hundreds of thousands of them around one registry
+//
+// the fd's of a namespace refer to their providers just like the registry's own, so publishing a provider applies to them too,
+//  a call looks its fd up under the namespace's own lock and reads the provider's table inside the registry's epoch,
+//  which never blocks, so it never waits for the registry's lock (see libsyscall/syscall_epoch.h)
+//
+// a namespace does not support stats, tracing, pins, close observers, idle timeouts or result caches, those stay with the fd's of the registry itself
+//
+// destroy callbacks run while the namespace is locked, they may make syscalls on the fd being destroyed
+//  and allocate or deallocate other fd's of the namespace, publishing never locks a namespace, so they may publish too
+//
+// every namespace must be destroyed before its registry
+//
+template <typename Table>
+struct SyscallNamespace {
+	using SyscallProvider = SYSCALL_BASE::SyscallProvider;
+	using SyscallTable = SYSCALL_BASE::SyscallTable;
+	using Slot = SYSCALL_BASE::Slot;
+
+	Table & registry;
+
+	LIBSYSCALL__MUTEX_VARIABLE
+
+	// the registry is not locked, it only counts its namespaces
+	inline SyscallNamespace(Table & registry) : registry(registry) {
+		registry.namespaces.fetch_add(1, std::memory_order_seq_cst);
+	}
+
+	SyscallNamespace(const SyscallNamespace &) = delete;
+	SyscallNamespace & operator=(const SyscallNamespace &) = delete;
+
+	// destroys every fd that is still open, as if the registry was being destroyed
+	inline ~SyscallNamespace() {
+		LIBSYSCALL__MUTEX_GUARD_VARIABLE
+		// destroy callbacks may close or open other fd's, so this goes on until the table is empty
+		std::vector<int> open;
+		while (descriptor_list.size() != 0) {
+			open.clear();
+			descriptor_list.for_each([&](int fd, Entry &) { open.push_back(fd); });
+			for (int fd : open) {
+				if (descriptor_list.get(fd) != nullptr) destroy_fd(fd, true);
+			}
+		}
+		registry.namespaces.fetch_sub(1, std::memory_order_seq_cst);
+	}
+
+	// binds a new fd of this namespace to 'provider' of the registry, see 'SYSCALL_BASE::allocate_fd'
+	inline int allocate_fd(SyscallProvider & provider, void * resource, WL_SYSCALLS_FD_ALLOCATOR_CALLBACK___DESTROY_DATA destroy_callback) {
+		libsyscall__slab * slab = provider.slabs.owner(resource);
+		LIBSYSCALL__MUTEX_GUARD_VARIABLE
+		return descriptor_list.allocate(Entry { { resource, &provider }, destroy_callback, slab });
+	}
+
+	// runs the destroy callback of 'fd' and frees it, does nothing if 'fd' is not open
+	inline void deallocate_fd(int fd) {
+		LIBSYSCALL__MUTEX_GUARD_VARIABLE
+		if (descriptor_list.get(fd) == nullptr) return;
+		destroy_fd(fd, false);
+	}
+
+	// true if 'fd' is open
+	inline bool valid(int fd) {
+		LIBSYSCALL__MUTEX_SHARED_GUARD_VARIABLE
+		return descriptor_list.get(fd) != nullptr;
+	}
+
+	// the number of open fd's
+	inline size_t size() {
+		LIBSYSCALL__MUTEX_SHARED_GUARD_VARIABLE
+		return descriptor_list.size();
+	}
+
+	// invoke syscall 'S' on 'fd', see 'SYSCALLS::call'
+	template <typename S, typename ... Args>
+	inline typename S::return_type call(int fd, Args && ... args) {
+		static_assert(Table::template contains<S>, "syscall is not part of this syscall table");
+		void * data = nullptr;
+		void * entry = nullptr;
+		bool intercepted = false;
+		if (!resolve(fd, Table::template id<S>, &data, &entry, &intercepted)) {
+			std::string msg = "SyscallNamespace ERROR: fd (" + std::to_string(fd) + ") is not valid";
+			throw new std::runtime_error(msg.c_str());
+		}
+		SYSCALL_BASE::SyscallEntryReference reference(entry, intercepted);
+		if (intercepted) {
+			SyscallResult<typename S::return_type> r = libsyscall__intercept<typename S::function_type>::invoke(entry, fd, data, std::forward<Args>(args)...);
+			if (!r.ok()) {
+				std::string msg = "SyscallNamespace ERROR: syscall was rejected with error " + std::to_string(r.error());
+				throw new std::runtime_error(msg.c_str());
+			}
+			if constexpr (!std::is_void<typename S::return_type>::value) return std::move(*r);
+			else return;
+		}
+		typename S::function_type callback = (typename S::function_type)entry;
+		if (callback != nullptr) return callback(fd, data, std::forward<Args>(args)...);
+		throw new std::runtime_error("callback not supported");
+	}
+
+	// invoke syscall 'S' on 'fd' without throwing, see 'SYSCALLS::try_call'
+	template <typename S, typename ... Args>
+	inline SyscallResult<typename S::return_type> try_call(int fd, Args && ... args) {
+		static_assert(Table::template contains<S>, "syscall is not part of this syscall table");
+		using R = typename S::return_type;
+		void * data = nullptr;
+		void * entry = nullptr;
+		bool intercepted = false;
+		if (!resolve(fd, Table::template id<S>, &data, &entry, &intercepted)) return SyscallResult<R>::failure(EBADF);
+		SYSCALL_BASE::SyscallEntryReference reference(entry, intercepted);
+		if (intercepted) {
+			return libsyscall__intercept<typename S::function_type>::invoke(entry, fd, data, std::forward<Args>(args)...);
+		}
+		typename S::function_type callback = (typename S::function_type)entry;
+		if (callback == nullptr) return SyscallResult<R>::failure(ENOSYS);
+		if constexpr (std::is_void<R>::value) {
+			callback(fd, data, std::forward<Args>(args)...);
+			return SyscallResult<R>();
+		}
+		else {
+			return SyscallResult<R>(callback(fd, data, std::forward<Args>(args)...));
+		}
+	}
+
+protected:
+	// what the fd table holds for every fd, the same as 'SYSCALL_BASE::Resource' without pins and idle timers
+	struct Entry {
+		Slot slot;
+		WL_SYSCALLS_FD_ALLOCATOR_CALLBACK___DESTROY_DATA callback;
+		libsyscall__slab * slab;
+	};
+	FdTable<Entry> descriptor_list;
+
+	// see 'SYSCALL_BASE::resolve', the fd is kept alive by our shared lock and its table by the registry's epoch
+	inline bool resolve(int fd, size_t id, void ** data, void ** callback, bool * intercepted) {
+		LIBSYSCALL__MUTEX_SHARED_GUARD_VARIABLE
+		Entry * e = descriptor_list.get(fd);
+		if (e == nullptr) return false;
+		LIBSYSCALL__EPOCH_GUARD_ON(registry)
+		SyscallTable * table = static_cast<SyscallProvider*>(e->slot.table)->table.load(std::memory_order_seq_cst);
+		*data = e->slot.data;
+		*callback = table->syscalls[id];
+		*intercepted = table->intercepts(id);
+		if (*intercepted) table->reference();
+		return true;
+	}
+
+	// see 'SYSCALL_BASE::destroy_fd', the caller must hold 'mutex' exclusively
+	inline void destroy_fd(int fd, bool in_destructor) {
+		Entry * e = descriptor_list.get(fd);
+		SyscallProvider * provider = static_cast<SyscallProvider*>(e->slot.table);
+		void * data = e->slot.data;
+		libsyscall__slab * slab = e->slab;
+		WL_SYSCALLS_FD_ALLOCATOR_CALLBACK___DESTROY_DATA callback = e->callback;
+		e->callback = nullptr;
+		if (in_destructor && !provider->teardown_callbacks) callback = nullptr;
+		if (callback != nullptr) callback(fd, &e->slot.data, in_destructor);
+		// the callback may have allocated fd's, which never moves 'e'
+		bool release = slab != nullptr && e->slot.data == data;
+		descriptor_list.deallocate(fd);
+		// unlike the registry's own, the pools outlive a namespace, so their blocks are always returned
+		if (release) slab->release(data);
+	}
+};
+
+#endif // LIBSYSCALL_SYSCALL_NAMESPACE_H
@@ -0,0 +1,467 @@
+#ifndef LIBSYSCALL_SYSCALL_POLL_H
+#define LIBSYSCALL_SYSCALL_POLL_H
+
+#include <libsyscall/libsyscall.h>
+#include <mutex>
+#include <chrono>
+#include <climits>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <time.h>
+#else
+#include <condition_variable>
+#endif
+
+// readiness notification for libsyscall fd's, modeled after epoll
+//
+// providers report the readiness of their fd's with 'signal' (or 'raise' / 'lower'),
+//  consumers create poll instances, which are fd's themselves, register interest in fd's with 'control',
+//  and block in 'wait' until some of them are ready
+//
+// every watched fd keeps a list of the instances watching it, and every instance keeps a list of its ready watches,
+//  so a readiness change costs O(watchers of that fd), and 'wait' costs O(ready), independent of how many fd's are watched
+//
+// closing a watched fd removes it from every instance, like closing an fd removes it from an epoll set
+//
+// readiness is only recorded for open fd's, a provider that signals an fd after closing it does not mark the fd that reuses its number,
+//  unless that fd was already opened when the signal is checked, the overloads taking the provider and resource of the fd also rule that out
+//
+
+// readiness bits, 'SYSCALL_POLL_ERR' and 'SYSCALL_POLL_HUP' are always reported, whether asked for or not
+#define SYSCALL_POLL_IN  0x001u
+#define SYSCALL_POLL_PRI 0x002u
+#define SYSCALL_POLL_OUT 0x004u
+#define SYSCALL_POLL_ERR 0x008u
+#define SYSCALL_POLL_HUP 0x010u
+
+// edge triggered, the watch is reported once per transition to ready instead of for as long as it stays ready
+#define SYSCALL_POLL_ET  0x80000000u
+
+#define SYSCALL_POLL_CTL_ADD 1
+#define SYSCALL_POLL_CTL_DEL 2
+#define SYSCALL_POLL_CTL_MOD 3
+
+struct SyscallPollEvent {
+	uint32_t events;
+	uint64_t user_data;
+};
+
+// a 32 bit word that threads can sleep on until it changes, a futex on linux and a condition variable elsewhere
+struct libsyscall__wait_word {
+	std::atomic<uint32_t> value = { 0 };
+
+#if defined(__linux__)
+	static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be a plain 32 bit integer");
+
+	// returns when 'value' no longer equals 'expected', when 'timeout_ms' (if not negative) elapsed, or spuriously
+	inline void wait(uint32_t expected, int timeout_ms) {
+		struct timespec timeout;
+		struct timespec * t = nullptr;
+		if (timeout_ms >= 0) {
+			timeout.tv_sec = timeout_ms / 1000;
+			timeout.tv_nsec = (long)(timeout_ms % 1000) * 1000000;
+			t = &timeout;
+		}
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(&value), FUTEX_WAIT_PRIVATE, expected, t, nullptr, 0);
+	}
+
+	inline void wake_all() {
+		value.fetch_add(1, std::memory_order_release);
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(&value), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+	}
+#else
+	std::mutex mutex;
+	std::condition_variable condition;
+
+	inline void wait(uint32_t expected, int timeout_ms) {
+		std::unique_lock<std::mutex> lock(mutex);
+		auto changed = [&] { return value.load(std::memory_order_acquire) != expected; };
+		if (timeout_ms < 0) condition.wait(lock, changed);
+		else condition.wait_for(lock, std::chrono::milliseconds(timeout_ms), changed);
+	}
+
+	inline void wake_all() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			value.fetch_add(1, std::memory_order_release);
+		}
+		condition.notify_all();
+	}
+#endif
+};
+
+struct SyscallPoll {
+	struct Instance;
+
+	// the interest of one instance in one fd
+	struct Watch {
+		Instance * instance;
+		int fd;
+		uint32_t events;
+		uint64_t user_data;
+		// edges not yet delivered, edge triggered watches only
+		uint32_t pending = 0;
+		bool queued = false;
+		// the watchers of 'fd'
+		Watch * fd_prev = nullptr;
+		Watch * fd_next = nullptr;
+		// the ready list of 'instance'
+		Watch * ready_prev = nullptr;
+		Watch * ready_next = nullptr;
+		// all watches of 'instance'
+		Watch * instance_prev = nullptr;
+		Watch * instance_next = nullptr;
+
+		inline uint32_t interest() const {
+			return (events & ~SYSCALL_POLL_ET) | SYSCALL_POLL_ERR | SYSCALL_POLL_HUP;
+		}
+
+		inline bool edge_triggered() const {
+			return (events & SYSCALL_POLL_ET) != 0;
+		}
+	};
+
+	struct Instance {
+		int fd;
+		Watch * watches = nullptr;
+		Watch * ready_head = nullptr;
+		Watch * ready_tail = nullptr;
+		size_t ready_count = 0;
+		// threads inside 'wait', the instance is freed by whoever leaves it last once it is closed
+		size_t users = 0;
+		size_t waiters = 0;
+		bool closed = false;
+		libsyscall__wait_word wakeup;
+	};
+
+	// per fd state, indexed by fd
+	struct Entry {
+		uint32_t ready = 0;
+		// bumped whenever the fd is closed, see 'change'
+		uint64_t closes = 0;
+		Watch * watchers = nullptr;
+		// set if this fd is a poll instance
+		Instance * instance = nullptr;
+	};
+
+	SYSCALL_BASE & sys;
+	// the provider of poll instance fd's, it implements no syscalls
+	SYSCALL_BASE::SyscallProvider & provider;
+
+	std::mutex mutex;
+	std::vector<Entry> entries;
+
+	inline SyscallPoll(SYSCALL_BASE & sys) : sys(sys), provider(sys.create_provider_entry()) {
+		sys.add_close_observer(on_close, this);
+	}
+
+	SyscallPoll(const SyscallPoll &) = delete;
+	SyscallPoll & operator=(const SyscallPoll &) = delete;
+
+	// closes every poll instance that is still open
+	inline ~SyscallPoll() {
+		std::vector<int> open;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (Entry & entry : entries) {
+				if (entry.instance != nullptr) open.push_back(entry.instance->fd);
+			}
+		}
+		for (int fd : open) {
+			sys.deallocate_fd(provider, fd);
+		}
+		sys.remove_close_observer(on_close, this);
+	}
+
+	// creates a poll instance, returns its fd
+	inline int create() {
+		int fd = sys.allocate_fd(provider, nullptr, nullptr);
+		Instance * instance = new Instance();
+		instance->fd = fd;
+		std::lock_guard<std::mutex> lock(mutex);
+		entry(fd).instance = instance;
+		return fd;
+	}
+
+	// adds, modifies or removes the interest of poll instance 'poll_fd' in 'fd'
+	//
+	// returns 0, or -EBADF if either fd is invalid, -EEXIST when adding a watched fd, -ENOENT when changing an unwatched one,
+	//  -EINVAL for an unknown operation or when trying to watch an instance with itself
+	//
+	inline int control(int poll_fd, int op, int fd, uint32_t events, uint64_t user_data) {
+		if (op != SYSCALL_POLL_CTL_ADD && op != SYSCALL_POLL_CTL_DEL && op != SYSCALL_POLL_CTL_MOD) return -EINVAL;
+		if (poll_fd == fd) return -EINVAL;
+		if (!sys.valid(fd)) return -EBADF;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			Instance * instance = instance_of(poll_fd);
+			if (instance == nullptr) return -EBADF;
+			Watch * watch = find(instance, fd);
+			if (op == SYSCALL_POLL_CTL_ADD) {
+				if (watch != nullptr) return -EEXIST;
+				watch = new Watch();
+				watch->instance = instance;
+				watch->fd = fd;
+				link_fd(watch);
+				link_instance(watch);
+			}
+			else if (watch == nullptr) {
+				return -ENOENT;
+			}
+			else if (op == SYSCALL_POLL_CTL_DEL) {
+				destroy(watch);
+				return 0;
+			}
+			watch->events = events;
+			watch->user_data = user_data;
+			// report readiness that was already present, like epoll does
+			uint32_t ready = entry(fd).ready & watch->interest();
+			watch->pending = watch->edge_triggered() ? ready : 0;
+			if (ready != 0) enqueue(watch);
+		}
+		// 'fd' may have been closed after it was checked but before it was watched, in which case the close missed this watch
+		if (op == SYSCALL_POLL_CTL_ADD && !sys.valid(fd)) {
+			std::lock_guard<std::mutex> lock(mutex);
+			Instance * instance = instance_of(poll_fd);
+			Watch * watch = instance == nullptr ? nullptr : find(instance, fd);
+			if (watch != nullptr) destroy(watch);
+			return -EBADF;
+		}
+		return 0;
+	}
+
+	// waits until at least one watched fd of poll instance 'poll_fd' is ready, and reports up to 'max' of them
+	//
+	// 'timeout_ms' < 0 waits forever, 0 does not block
+	//
+	// returns the number of events written, 0 on timeout, -EBADF if 'poll_fd' is not a poll instance or was closed while waiting
+	//
+	inline int wait(int poll_fd, SyscallPollEvent * events, int max, int timeout_ms) {
+		if (max <= 0) return -EINVAL;
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms < 0 ? 0 : timeout_ms);
+		std::unique_lock<std::mutex> lock(mutex);
+		Instance * instance = instance_of(poll_fd);
+		if (instance == nullptr) return -EBADF;
+		instance->users++;
+		int result;
+		for (;;) {
+			if (instance->closed) {
+				result = -EBADF;
+				break;
+			}
+			result = deliver(instance, events, max);
+			if (result != 0 || timeout_ms == 0) break;
+			int remaining = -1;
+			if (timeout_ms > 0) {
+				auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+				if (left <= 0) break;
+				remaining = (int)left;
+			}
+			uint32_t expected = instance->wakeup.value.load(std::memory_order_acquire);
+			instance->waiters++;
+			lock.unlock();
+			instance->wakeup.wait(expected, remaining);
+			lock.lock();
+			instance->waiters--;
+		}
+		instance->users--;
+		if (instance->closed && instance->users == 0) delete instance;
+		return result;
+	}
+
+	// replaces the readiness of 'fd', called by the provider of 'fd' whenever it changes, ignored if 'fd' is not open
+	inline void signal(int fd, uint32_t ready) {
+		change(fd, [&] { return sys.valid(fd); }, [ready](uint32_t) { return ready; });
+	}
+
+	// marks 'bits' of 'fd' as ready
+	inline void raise(int fd, uint32_t bits) {
+		change(fd, [&] { return sys.valid(fd); }, [bits](uint32_t ready) { return ready | bits; });
+	}
+
+	// marks 'bits' of 'fd' as no longer ready
+	inline void lower(int fd, uint32_t bits) {
+		change(fd, [&] { return sys.valid(fd); }, [bits](uint32_t ready) { return ready & ~bits; });
+	}
+
+	// these are ignored unless 'fd' is still open on 'provider' with resource 'data' (the one passed to 'allocate_fd'),
+	//  so a provider that signals an fd it closed meanwhile never marks an fd opened on that number since
+	inline void signal(int fd, const SYSCALL_BASE::SyscallProvider & provider, const void * data, uint32_t ready) {
+		change(fd, [&] { return sys.valid(fd, provider, data); }, [ready](uint32_t) { return ready; });
+	}
+
+	inline void raise(int fd, const SYSCALL_BASE::SyscallProvider & provider, const void * data, uint32_t bits) {
+		change(fd, [&] { return sys.valid(fd, provider, data); }, [bits](uint32_t ready) { return ready | bits; });
+	}
+
+	inline void lower(int fd, const SYSCALL_BASE::SyscallProvider & provider, const void * data, uint32_t bits) {
+		change(fd, [&] { return sys.valid(fd, provider, data); }, [bits](uint32_t ready) { return ready & ~bits; });
+	}
+
+	// closes poll instance 'poll_fd', threads blocked in 'wait' on it return -EBADF
+	inline void close(int poll_fd) {
+		sys.deallocate_fd(provider, poll_fd);
+	}
+
+private:
+	inline Entry & entry(int fd) {
+		if ((size_t)fd >= entries.size()) entries.resize((size_t)fd + 1);
+		return entries[fd];
+	}
+
+	inline Instance * instance_of(int fd) {
+		if (fd < 0 || (size_t)fd >= entries.size()) return nullptr;
+		return entries[fd].instance;
+	}
+
+	inline Watch * find(Instance * instance, int fd) {
+		if (fd < 0 || (size_t)fd >= entries.size()) return nullptr;
+		for (Watch * watch = entries[fd].watchers; watch != nullptr; watch = watch->fd_next) {
+			if (watch->instance == instance) return watch;
+		}
+		return nullptr;
+	}
+
+	// replaces the readiness of 'fd' with 'f(readiness)' if 'open()' holds
+	//
+	// 'open' is checked without holding 'mutex', which the close observer takes under the SYSCALL_BASE mutex,
+	//  and a close that slips in between is caught by 'closes'
+	//
+	// a close that comes before 'closes' is read is not caught, if the number was reused meanwhile only 'open' can tell
+	template <typename Open, typename F>
+	inline void change(int fd, Open open, F f) {
+		if (fd < 0) return;
+		uint64_t closes;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			closes = entry(fd).closes;
+		}
+		if (!open()) return;
+		std::lock_guard<std::mutex> lock(mutex);
+		Entry & e = entries[fd];
+		if (e.closes != closes) return;
+		update(fd, f(e.ready));
+	}
+
+	inline void update(int fd, uint32_t ready) {
+		Entry & e = entries[fd];
+		uint32_t rising = ready & ~e.ready;
+		e.ready = ready;
+		for (Watch * watch = e.watchers; watch != nullptr; watch = watch->fd_next) {
+			if (watch->edge_triggered()) {
+				uint32_t edges = rising & watch->interest();
+				if (edges == 0) continue;
+				watch->pending |= edges;
+			}
+			else if ((ready & watch->interest()) == 0) {
+				continue;
+			}
+			enqueue(watch);
+		}
+	}
+
+	inline void enqueue(Watch * watch) {
+		if (watch->queued) return;
+		Instance * instance = watch->instance;
+		watch->queued = true;
+		watch->ready_next = nullptr;
+		watch->ready_prev = instance->ready_tail;
+		if (instance->ready_tail != nullptr) instance->ready_tail->ready_next = watch;
+		else instance->ready_head = watch;
+		instance->ready_tail = watch;
+		instance->ready_count++;
+		if (instance->waiters != 0) instance->wakeup.wake_all();
+	}
+
+	inline void dequeue(Watch * watch) {
+		if (!watch->queued) return;
+		Instance * instance = watch->instance;
+		if (watch->ready_prev != nullptr) watch->ready_prev->ready_next = watch->ready_next;
+		else instance->ready_head = watch->ready_next;
+		if (watch->ready_next != nullptr) watch->ready_next->ready_prev = watch->ready_prev;
+		else instance->ready_tail = watch->ready_prev;
+		watch->queued = false;
+		instance->ready_count--;
+	}
+
+	// walks the ready list once, level triggered watches that are still ready go back to its end
+	inline int deliver(Instance * instance, SyscallPollEvent * events, int max) {
+		int count = 0;
+		size_t budget = instance->ready_count;
+		while (budget-- != 0 && count < max) {
+			Watch * watch = instance->ready_head;
+			dequeue(watch);
+			uint32_t ready = entries[watch->fd].ready & watch->interest();
+			uint32_t report = watch->edge_triggered() ? watch->pending : ready;
+			watch->pending = 0;
+			if (report != 0) {
+				events[count++] = { report, watch->user_data };
+			}
+			if (!watch->edge_triggered() && ready != 0) {
+				watch->queued = false;
+				enqueue(watch);
+			}
+		}
+		return count;
+	}
+
+	inline void link_fd(Watch * watch) {
+		Entry & e = entry(watch->fd);
+		watch->fd_prev = nullptr;
+		watch->fd_next = e.watchers;
+		if (e.watchers != nullptr) e.watchers->fd_prev = watch;
+		e.watchers = watch;
+	}
+
+	inline void link_instance(Watch * watch) {
+		Instance * instance = watch->instance;
+		watch->instance_prev = nullptr;
+		watch->instance_next = instance->watches;
+		if (instance->watches != nullptr) instance->watches->instance_prev = watch;
+		instance->watches = watch;
+	}
+
+	inline void destroy(Watch * watch) {
+		dequeue(watch);
+		Entry & e = entries[watch->fd];
+		if (watch->fd_prev != nullptr) watch->fd_prev->fd_next = watch->fd_next;
+		else e.watchers = watch->fd_next;
+		if (watch->fd_next != nullptr) watch->fd_next->fd_prev = watch->fd_prev;
+		Instance * instance = watch->instance;
+		if (watch->instance_prev != nullptr) watch->instance_prev->instance_next = watch->instance_next;
+		else instance->watches = watch->instance_next;
+		if (watch->instance_next != nullptr) watch->instance_next->instance_prev = watch->instance_prev;
+		delete watch;
+	}
+
+	// runs under the exclusive SYSCALL_BASE mutex, drops every watch of 'fd' and, if it is a poll instance, the instance itself
+	static inline void on_close(void * user, int fd) {
+		SyscallPoll & poll = *static_cast<SyscallPoll*>(user);
+		std::lock_guard<std::mutex> lock(poll.mutex);
+		if (fd < 0) return;
+		Entry & e = poll.entry(fd);
+		e.closes++;
+		while (e.watchers != nullptr) {
+			poll.destroy(e.watchers);
+		}
+		e.ready = 0;
+		Instance * instance = e.instance;
+		if (instance == nullptr) return;
+		e.instance = nullptr;
+		while (instance->watches != nullptr) {
+			poll.destroy(instance->watches);
+		}
+		instance->closed = true;
+		if (instance->users == 0) {
+			delete instance;
+		}
+		else {
+			instance->wakeup.wake_all();
+		}
+	}
+};
+
+#endif // LIBSYSCALL_SYSCALL_POLL_H
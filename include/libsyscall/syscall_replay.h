@@ -0,0 +1,246 @@
+#ifndef LIBSYSCALL_SYSCALL_REPLAY_H
+#define LIBSYSCALL_SYSCALL_REPLAY_H
+
+#include <libsyscall/libsyscall.h>
+#include <libsyscall/syscall_trace.h>
+#include <vector>
+#include <tuple>
+#include <utility>
+#include <chrono>
+
+// deterministic replay of a recorded trace, see 'syscall_trace.h'
+//
+// SyscallReplay<MY_SYSCALLS> replay(SYS);
+// SyscallReplayResult r = replay.run(SyscallTrace::load("app.trace"));
+//
+// records are re-issued one after another on the calling thread, in the order they were recorded,
+//  so two replays of the same trace perform exactly the same sequence of operations
+//
+// every recorded provider is replayed on a stub provider of its own, whose syscalls do nothing and return a value initialized result,
+//  'bind' replays a recorded provider on a real one instead
+//
+// a trace only holds the sizes of the arguments, stubs are called with value initialized ones,
+//  a real provider only receives the calls of syscalls that take no arguments or that 'arguments' was given for, the others are skipped
+//
+template <typename S, typename Function = typename S::function_type>
+struct libsyscall__replay_syscall;
+
+template <typename S, typename R, typename ... Args>
+struct libsyscall__replay_syscall<S, R(*)(int, void*, Args...)> {
+	// fills in the arguments of a replayed call, see 'SyscallReplay::arguments'
+	using fill_function = void (*)(const SyscallTraceRecord & record, typename S::argument_tuple & arguments, void * user);
+
+	static inline R stub(int, void*, Args...) {
+		if constexpr (!std::is_void<R>::value) return R();
+	}
+
+	template <typename Table, size_t ... I>
+	static inline int issue(Table & sys, int fd, const SyscallTraceRecord & record, bool real, void * fill, void * user, std::index_sequence<I...>) {
+		typename S::argument_tuple arguments{};
+		if (real && sizeof...(Args) != 0) {
+			if (fill == nullptr) return -1;
+			reinterpret_cast<fill_function>(fill)(record, arguments, user);
+		}
+		return sys.template try_call<S>(fd, static_cast<Args>(std::get<I>(arguments))...).error();
+	}
+
+	// returns the error of the call, 0 if it succeeded, or -1 if it was not issued
+	//
+	// 'real' - 'fd' belongs to a provider given to 'bind', whose calls need their arguments filled in by 'fill'
+	template <typename Table>
+	static inline int issue(Table & sys, int fd, const SyscallTraceRecord & record, bool real, void * fill, void * user) {
+		return issue(sys, fd, record, real, fill, user, std::index_sequence_for<Args...>());
+	}
+};
+
+struct SyscallReplayResult {
+	uint64_t allocations = 0;
+	uint64_t deallocations = 0;
+	uint64_t calls = 0;
+	// calls that failed with EBADF or ENOSYS
+	uint64_t failed_calls = 0;
+	// calls on a provider given to 'bind' that were not issued, because their syscall takes arguments and 'arguments' was not given for it
+	uint64_t skipped_calls = 0;
+	// records that could not be replayed, for example the close of an fd that was opened before recording started
+	uint64_t skipped = 0;
+	// wall time of the whole replay
+	uint64_t elapsed_ns = 0;
+};
+
+template <typename Table>
+struct SyscallReplay {
+	using SyscallProvider = SYSCALL_BASE::SyscallProvider;
+
+	// where the fd's of a recorded provider are replayed
+	struct Binding {
+		SyscallProvider * provider = nullptr;
+		// false for the stub providers the replay creates
+		bool real = false;
+		// creates the resource of a replayed fd, nullptr - fd's get a nullptr resource
+		void * (*resource)(void * user) = nullptr;
+		WL_SYSCALLS_FD_ALLOCATOR_CALLBACK___DESTROY_DATA destroy = nullptr;
+		void * user = nullptr;
+	};
+
+	inline SyscallReplay(Table & sys) : sys(sys) {}
+
+	SyscallReplay(const SyscallReplay &) = delete;
+	SyscallReplay & operator=(const SyscallReplay &) = delete;
+
+	// closes every fd the replay opened that is still open
+	inline ~SyscallReplay() {
+		for (size_t i = 0; i < fds.size(); i++) {
+			if (fds[i].fd != -1) sys.deallocate_fd(*fds[i].provider, fds[i].fd);
+		}
+	}
+
+	// replay the fd's of 'recorded_provider' on 'provider', with resources created by 'resource'
+	inline void bind(uint32_t recorded_provider, SyscallProvider & provider, void * (*resource)(void * user) = nullptr, WL_SYSCALLS_FD_ALLOCATOR_CALLBACK___DESTROY_DATA destroy = nullptr, void * user = nullptr) {
+		if (recorded_provider >= bindings.size()) bindings.resize((size_t)recorded_provider + 1);
+		Binding & b = bindings[recorded_provider];
+		b.provider = &provider;
+		b.real = true;
+		b.resource = resource;
+		b.destroy = destroy;
+		b.user = user;
+	}
+
+	// the arguments of the replayed calls of syscall 'S' on the providers given to 'bind', built from the recorded call by 'fill'
+	//
+	// replay.arguments<SYS_READ>(+[](const SyscallTraceRecord & r, std::tuple<char*, size_t> & arguments, void * user) {
+	//     arguments = { static_cast<char*>(user), r.argument_bytes };
+	// }, buffer);
+	//
+	template <typename S>
+	inline void arguments(typename libsyscall__replay_syscall<S>::fill_function fill, void * user = nullptr) {
+		static_assert(Table::template contains<S>, "syscall is not part of this syscall table");
+		fills.resize(Table::count);
+		fills[Table::template id<S>] = { (void*)fill, user };
+	}
+
+	inline SyscallReplayResult run(const std::vector<SyscallTraceRecord> & records) {
+		return run(records.data(), records.size());
+	}
+
+	// replays 'count' records, fd's stay open across runs, so a long trace may be replayed in pieces
+	inline SyscallReplayResult run(const SyscallTraceRecord * records, size_t count) {
+		SyscallReplayResult result;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < count; i++) {
+			const SyscallTraceRecord & r = records[i];
+			switch (r.kind) {
+			case SYSCALL_TRACE_ALLOCATE:
+				if (r.fd < 0) {
+					result.skipped++;
+					break;
+				}
+				close(r.fd);
+				open(r.fd, r.provider);
+				result.allocations++;
+				break;
+			case SYSCALL_TRACE_DEALLOCATE:
+				if (close(r.fd)) result.deallocations++;
+				else result.skipped++;
+				break;
+			case SYSCALL_TRACE_CALL: {
+				if (r.syscall >= Table::count) {
+					result.skipped++;
+					break;
+				}
+				// an fd that was opened before recording started is opened the first time it is used,
+				//  a call that failed with EBADF is replayed on an fd that is never valid
+				int fd = -1;
+				bool real = false;
+				if (r.provider != SYSCALL_TRACE_NO_PROVIDER && r.fd >= 0) {
+					fd = replayed(r.fd);
+					if (fd == -1) fd = open(r.fd, r.provider);
+					real = fds[r.fd].real;
+				}
+				Fill fill = r.syscall < fills.size() ? fills[r.syscall] : Fill();
+				int error = dispatch()[r.syscall](sys, fd, r, real, fill.function, fill.user);
+				if (error == -1) {
+					result.skipped_calls++;
+					break;
+				}
+				if (error != 0) result.failed_calls++;
+				result.calls++;
+				break;
+			}
+			default:
+				result.skipped++;
+				break;
+			}
+		}
+		result.elapsed_ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		return result;
+	}
+
+private:
+	struct Replayed {
+		int fd = -1;
+		SyscallProvider * provider = nullptr;
+		bool real = false;
+	};
+
+	struct Fill {
+		void * function = nullptr;
+		void * user = nullptr;
+	};
+
+	Table & sys;
+	std::vector<Binding> bindings;
+	// indexed by recorded fd
+	std::vector<Replayed> fds;
+	// indexed by syscall id, see 'arguments'
+	std::vector<Fill> fills;
+
+	using issue_function = int (*)(Table & sys, int fd, const SyscallTraceRecord & record, bool real, void * fill, void * user);
+
+	template <typename ... Syscalls>
+	static inline const issue_function * dispatch_of(libsyscall__syscall_list<Syscalls...>) {
+		static const issue_function table[] = { &libsyscall__replay_syscall<Syscalls>::template issue<Table>..., nullptr };
+		return table;
+	}
+
+	static inline const issue_function * dispatch() {
+		return dispatch_of(libsyscall__syscalls_of<Table>());
+	}
+
+	template <typename ... Syscalls>
+	inline void publish_stubs(SyscallProvider & provider, libsyscall__syscall_list<Syscalls...>) {
+		sys.publish(provider, { Table::template entry<Syscalls>(&libsyscall__replay_syscall<Syscalls>::stub)... });
+	}
+
+	inline Binding & binding(uint32_t recorded_provider) {
+		if (recorded_provider >= bindings.size()) bindings.resize((size_t)recorded_provider + 1);
+		Binding & b = bindings[recorded_provider];
+		if (b.provider == nullptr) {
+			b.provider = &sys.create_provider_entry();
+			publish_stubs(*b.provider, libsyscall__syscalls_of<Table>());
+		}
+		return b;
+	}
+
+	inline int replayed(int recorded_fd) const {
+		return (size_t)recorded_fd < fds.size() ? fds[recorded_fd].fd : -1;
+	}
+
+	inline int open(int recorded_fd, uint32_t recorded_provider) {
+		Binding & b = binding(recorded_provider);
+		void * resource = b.resource != nullptr ? b.resource(b.user) : nullptr;
+		if ((size_t)recorded_fd >= fds.size()) fds.resize((size_t)recorded_fd + 1);
+		fds[recorded_fd].fd = sys.allocate_fd(*b.provider, resource, b.destroy);
+		fds[recorded_fd].provider = b.provider;
+		fds[recorded_fd].real = b.real;
+		return fds[recorded_fd].fd;
+	}
+
+	inline bool close(int recorded_fd) {
+		if (recorded_fd < 0 || (size_t)recorded_fd >= fds.size() || fds[recorded_fd].fd == -1) return false;
+		sys.deallocate_fd(*fds[recorded_fd].provider, fds[recorded_fd].fd);
+		fds[recorded_fd].fd = -1;
+		return true;
+	}
+};
+
+#endif // LIBSYSCALL_SYSCALL_REPLAY_H
@@ -0,0 +1,306 @@
+#ifndef LIBSYSCALL_SYSCALL_RING_H
+#define LIBSYSCALL_SYSCALL_RING_H
+
+#include <libsyscall/libsyscall.h>
+#include <tuple>
+#include <memory>
+#include <cstring>
+
+// batched syscall execution, loosely modeled after io_uring
+//
+// syscalls are prepared into a submission ring, 'submit' executes all of them at once,
+//  and their results are posted to a completion ring
+//
+// a batch costs a single shared lock for all of its fd lookups instead of one per call,
+//  all slots of a batch are looked up in one pass so that their cache misses overlap,
+//  and entries are executed grouped by provider
+//
+// a ring is not thread safe, it is meant to be owned by a single thread (for example an event loop),
+//  syscall implementations must not use the ring that is executing them
+//
+
+// the inline argument space of a submission, the arguments of a syscall must be trivially copyable and fit in here
+#define LIBSYSCALL_RING_ARGUMENT_SIZE 40
+
+// the inline result space of a completion, the return value of a syscall must be trivially copyable and fit in here
+#define LIBSYSCALL_RING_RESULT_SIZE 16
+
+// a submission ring entry, exactly one cache line
+struct alignas(64) SyscallSubmission {
+	int fd;
+	uint32_t id;
+	// returns 0, or the error of a rejected call when 'intercepted' is set
+	int (*invoke)(void * callback, bool intercepted, int fd, void * data, const unsigned char * arguments, unsigned char * result);
+	uint64_t user_data;
+	alignas(8) unsigned char arguments[LIBSYSCALL_RING_ARGUMENT_SIZE];
+};
+
+static_assert(sizeof(SyscallSubmission) == 64, "a submission must fill exactly one cache line");
+
+// a completion ring entry
+struct SyscallCompletion {
+	uint64_t user_data;
+	// 0 on success, EBADF if the fd was invalid, ENOSYS if its provider does not implement the syscall,
+	//  otherwise the error of a call rejected by its provider's interceptors or permissions
+	int error;
+	alignas(8) unsigned char result[LIBSYSCALL_RING_RESULT_SIZE];
+
+	template <typename T>
+	inline T result_as() const {
+		static_assert(std::is_trivially_copyable<T>::value && sizeof(T) <= LIBSYSCALL_RING_RESULT_SIZE, "result does not fit in a completion");
+		T value;
+		memcpy(&value, result, sizeof(T));
+		return value;
+	}
+};
+
+// packs a list of trivially copyable values into a byte buffer, each at its natural alignment
+template <typename ... T>
+struct libsyscall__argument_layout {
+	static constexpr size_t count = sizeof...(T);
+	static constexpr size_t sizes[count + 1] = { sizeof(T)..., 0 };
+	static constexpr size_t alignments[count + 1] = { alignof(T)..., 1 };
+
+	static constexpr size_t offset(size_t i) {
+		size_t o = 0;
+		for (size_t k = 0; k < i; k++) {
+			o = (o + alignments[k] - 1) / alignments[k] * alignments[k];
+			o += sizes[k];
+		}
+		return (o + alignments[i] - 1) / alignments[i] * alignments[i];
+	}
+
+	static constexpr size_t size = offset(count);
+
+	template <size_t ... I>
+	static inline void store(unsigned char * buffer, std::index_sequence<I...>, const T & ... values) {
+		(memcpy(buffer + offset(I), &values, sizeof(T)), ...);
+	}
+
+	template <size_t ... I>
+	static inline std::tuple<T...> load(const unsigned char * buffer, std::index_sequence<I...>) {
+		std::tuple<T...> values;
+		(memcpy(&std::get<I>(values), buffer + offset(I), sizeof(T)), ...);
+		return values;
+	}
+};
+
+template <typename F>
+struct libsyscall__ring_invoker;
+
+template <typename Ret, typename ... Args>
+struct libsyscall__ring_invoker<Ret(*)(int, void*, Args...)> {
+	using layout = libsyscall__argument_layout<typename std::decay<Args>::type...>;
+	using sequence = std::index_sequence_for<Args...>;
+
+	static_assert((std::is_trivially_copyable<typename std::decay<Args>::type>::value && ...), "ring submissions require trivially copyable arguments");
+	static_assert((std::is_default_constructible<typename std::decay<Args>::type>::value && ...), "ring submissions require default constructible arguments");
+	static_assert(layout::size <= LIBSYSCALL_RING_ARGUMENT_SIZE, "syscall arguments do not fit in a submission");
+	using result_type = typename std::conditional<std::is_void<Ret>::value, char, Ret>::type;
+
+	static_assert(std::is_trivially_copyable<result_type>::value && sizeof(result_type) <= LIBSYSCALL_RING_RESULT_SIZE, "syscall result does not fit in a completion");
+
+	template <typename ... A>
+	static inline void store(unsigned char * buffer, A && ... arguments) {
+		layout::store(buffer, sequence(), typename std::decay<Args>::type(std::forward<A>(arguments))...);
+	}
+
+	static int invoke(void * callback, bool intercepted, int fd, void * data, const unsigned char * arguments, unsigned char * result) {
+		auto values = layout::load(arguments, sequence());
+		if (intercepted) {
+			SyscallResult<Ret> r = std::apply([&](auto & ... a) { return libsyscall__intercept<Ret(*)(int, void*, Args...)>::invoke(callback, fd, data, a...); }, values);
+			if constexpr (!std::is_void<Ret>::value) {
+				if (r.ok()) memcpy(result, &*r, sizeof(Ret));
+			}
+			return r.error();
+		}
+		Ret (*function)(int, void*, Args...) = (Ret (*)(int, void*, Args...))callback;
+		if constexpr (std::is_void<Ret>::value) {
+			std::apply([&](auto & ... a) { function(fd, data, a...); }, values);
+		}
+		else {
+			Ret value = std::apply([&](auto & ... a) { return function(fd, data, a...); }, values);
+			memcpy(result, &value, sizeof(Ret));
+		}
+		return 0;
+	}
+};
+
+template <typename Table>
+struct SyscallRing {
+	Table & sys;
+	size_t mask;
+	std::unique_ptr<SyscallSubmission[]> submissions;
+	std::unique_ptr<SyscallCompletion[]> completions;
+
+	// per-submit scratch space, allocated once so that 'submit' never allocates
+	std::unique_ptr<int[]> fds;
+	std::unique_ptr<uint32_t[]> ids;
+	std::unique_ptr<SYSCALL_BASE::SyscallResolved[]> resolved;
+	std::unique_ptr<uint32_t[]> order;
+	std::unique_ptr<uint8_t[]> group;
+
+	// the number of provider groups a batch is sorted into
+	static const size_t GROUPS = 64;
+
+	size_t sq_head = 0;
+	size_t sq_tail = 0;
+	size_t cq_head = 0;
+	size_t cq_tail = 0;
+
+	// 'entries' is rounded up to a power of two, both rings have the same size
+	inline SyscallRing(Table & sys, size_t entries) : sys(sys) {
+		size_t size = 1;
+		while (size < entries) size <<= 1;
+		mask = size - 1;
+		submissions.reset(new SyscallSubmission[size]);
+		completions.reset(new SyscallCompletion[size]);
+		fds.reset(new int[size]);
+		ids.reset(new uint32_t[size]);
+		resolved.reset(new SYSCALL_BASE::SyscallResolved[size]);
+		order.reset(new uint32_t[size]);
+		group.reset(new uint8_t[size]);
+	}
+
+	inline size_t capacity() const { return mask + 1; }
+
+	// the number of prepared entries that have not been submitted yet
+	inline size_t pending() const { return sq_tail - sq_head; }
+
+	// the number of completions waiting to be consumed
+	inline size_t ready() const { return cq_tail - cq_head; }
+
+	// queue syscall 'S' on 'fd', returns false if the submission ring is full
+	//
+	// 'user_data' is passed back unchanged in the completion
+	//
+	template <typename S, typename ... Args>
+	inline bool prepare(int fd, uint64_t user_data, Args && ... args) {
+		static_assert(Table::template contains<S>, "syscall is not part of this syscall table");
+		using invoker = libsyscall__ring_invoker<typename S::function_type>;
+		if (pending() == capacity()) return false;
+		SyscallSubmission & entry = submissions[sq_tail & mask];
+		entry.fd = fd;
+		entry.id = (uint32_t)Table::template id<S>;
+		entry.invoke = invoker::invoke;
+		entry.user_data = user_data;
+		invoker::store(entry.arguments, std::forward<Args>(args)...);
+		sq_tail++;
+		return true;
+	}
+
+	// execute prepared entries, returns how many were executed
+	//
+	// at most as many entries are executed as there is free space in the completion ring
+	//
+	// entries are executed grouped by provider, and in submission order within a provider,
+	//  use 'user_data' to match completions to submissions
+	//
+	// exceptions thrown by an implementation propagate out of 'submit', entries after it in the batch are dropped
+	//
+	inline size_t submit() {
+		size_t count = pending();
+		size_t space = capacity() - ready();
+		if (count > space) count = space;
+		if (count == 0) return 0;
+
+		const size_t head = sq_head;
+		for (size_t i = 0; i < count; i++) {
+			const SyscallSubmission & entry = submissions[(head + i) & mask];
+			fds[i] = entry.fd;
+			ids[i] = entry.id;
+		}
+		sys.resolve_batch(count, fds.get(), ids.get(), resolved.get());
+
+		group_by_provider(count);
+
+		// consumed up front, so that an exception leaves both rings consistent
+		sq_head += count;
+
+		size_t k = 0;
+		try {
+			for (; k < count; k++) {
+				size_t i = order[k];
+				const SyscallSubmission & entry = submissions[(head + i) & mask];
+				SyscallCompletion & completion = completions[cq_tail & mask];
+				completion.user_data = entry.user_data;
+				// 'resolve_batch' referenced the table of an intercepted entry
+				SYSCALL_BASE::SyscallEntryReference reference(resolved[i].callback, resolved[i].intercepted);
+				if (resolved[i].provider == nullptr) {
+					completion.error = EBADF;
+				}
+				else if (resolved[i].callback == nullptr) {
+					completion.error = ENOSYS;
+				}
+				else {
+					completion.error = entry.invoke(resolved[i].callback, resolved[i].intercepted, entry.fd, resolved[i].data, entry.arguments, completion.result);
+				}
+				cq_tail++;
+			}
+		}
+		catch (...) {
+			// the dropped entries still hold their references
+			for (k++; k < count; k++) {
+				SYSCALL_BASE::SyscallEntryReference reference(resolved[order[k]].callback, resolved[order[k]].intercepted);
+			}
+			throw;
+		}
+		return count;
+	}
+
+	// fills 'order' with the entry indices of this batch grouped by provider, in submission order within a group
+	//
+	// this is a counting sort on the provider index, providers whose indices are 'GROUPS' apart share a group,
+	//  entries with an invalid fd are placed last
+	//
+	inline void group_by_provider(size_t count) {
+		size_t highest = 0;
+		bool single = true;
+		for (size_t i = 0; i < count; i++) {
+			SYSCALL_BASE::SyscallProvider * provider = resolved[i].provider;
+			size_t g = provider == nullptr ? GROUPS : provider->index % GROUPS;
+			group[i] = (uint8_t)g;
+			if (g > highest) highest = g;
+			if (g != group[0]) single = false;
+		}
+		if (single) {
+			for (size_t i = 0; i < count; i++) {
+				order[i] = (uint32_t)i;
+			}
+			return;
+		}
+		// only the groups up to 'highest' are used, small batches rarely reach the invalid fd group
+		uint32_t offsets[GROUPS + 2];
+		for (size_t g = 0; g <= highest + 1; g++) {
+			offsets[g] = 0;
+		}
+		for (size_t i = 0; i < count; i++) {
+			offsets[group[i] + 1]++;
+		}
+		for (size_t g = 0; g < highest; g++) {
+			offsets[g + 1] += offsets[g];
+		}
+		for (size_t i = 0; i < count; i++) {
+			order[offsets[group[i]]++] = (uint32_t)i;
+		}
+	}
+
+	// the oldest completion, or nullptr if there is none, call 'advance' once it has been consumed
+	inline const SyscallCompletion * peek() const {
+		return ready() == 0 ? nullptr : &completions[cq_head & mask];
+	}
+
+	inline void advance() {
+		cq_head++;
+	}
+
+	// copies out and consumes the oldest completion, returns false if there is none
+	inline bool pop(SyscallCompletion & completion) {
+		if (ready() == 0) return false;
+		completion = completions[cq_head & mask];
+		cq_head++;
+		return true;
+	}
+};
+
+#endif // LIBSYSCALL_SYSCALL_RING_H
@@ -0,0 +1,752 @@
+#ifndef LIBSYSCALL_SYSCALL_SHARED_H
+#define LIBSYSCALL_SYSCALL_SHARED_H
+
+#include <libsyscall/libsyscall.h>
+#include <libsyscall/syscall_ring.h>
+
+#if !defined(__linux__)
+#error "libsyscall/syscall_shared.h is only supported on linux"
+#endif
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <climits>
+#include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+// one fd namespace shared by several processes on the same host
+//
+// SyscallSharedSegment segment; // created before forking, the children inherit it
+// fork();
+//
+// // in every process
+// SyscallShared<MY_SYSCALLS> shared(SYS, segment);
+// std::thread server([&] { shared.serve(); }); // runs the calls other processes make on this process's fd's
+//
+// int global = shared.share(fd);                     // 'global' now means the same thing in every process
+// int r = shared.call<SYS_READ>(global, buffer, 16); // direct if this process owns 'global', forwarded to its owner otherwise
+//
+// the segment holds the global fd table and one request ring per process, fd's are allocated with process-shared atomics
+//
+// providers and resources stay in the process that created them, a call on an fd owned by another process
+//  is copied into the owner's request ring and executed there, the caller sleeps on a futex until the reply arrives
+//
+// forwarded calls have the same restrictions as SyscallRing submissions, trivially copyable arguments of at most
+//  LIBSYSCALL_RING_ARGUMENT_SIZE bytes and a trivially copyable result of at most LIBSYSCALL_RING_RESULT_SIZE bytes,
+//  other syscalls fail with ENOTSUP when they are forwarded
+//
+// a forwarded call whose owner exits before replying fails with EPIPE
+//
+// a process that exits without destroying its SyscallShared keeps its slot until another process reaps it,
+//  which happens when a process attaches, or when a call on one of its fd's finds it gone,
+//  reaping unshares its global fd's and fails the calls still queued for it with EPIPE
+//
+// a caller that gives up on a reply abandons its reply slot, and whoever completes the call later returns the slot to the pool,
+//  the slot of a call whose owner died while running it is never returned
+//
+
+struct SyscallSharedOptions {
+	// the size of the global fd table
+	uint32_t fds = 65536;
+	// the number of processes that may be attached at once
+	uint32_t processes = 64;
+	// the size of every process's request ring, rounded up to a power of two
+	uint32_t ring_entries = 1024;
+	// the number of forwarded calls that may be in flight at once, across all processes
+	uint32_t replies = 4096;
+};
+
+#define LIBSYSCALL_SHARED_MAGIC 0x6C69627379736361ull
+#define LIBSYSCALL_SHARED_VERSION 2
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free, "shared segments require lock free atomics");
+
+inline void libsyscall__shared_futex_wait(std::atomic<uint32_t> * word, uint32_t expected, int timeout_ms) {
+	struct timespec timeout;
+	timeout.tv_sec = timeout_ms / 1000;
+	timeout.tv_nsec = (long)(timeout_ms % 1000) * 1000000;
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+}
+
+inline void libsyscall__shared_futex_wake(std::atomic<uint32_t> * word) {
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+// false once 'pid' has exited, a process that exited but has not been reaped yet counts as exited
+inline bool libsyscall__shared_alive(int32_t pid) {
+	if (kill(pid, 0) != 0 && errno == ESRCH) return false;
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+	FILE * file = fopen(path, "r");
+	if (file == nullptr) return true;
+	char stat[512];
+	size_t n = fread(stat, 1, sizeof(stat) - 1, file);
+	fclose(file);
+	stat[n] = 0;
+	// the state follows the parenthesized command name, which may itself contain ')'
+	const char * state = strrchr(stat, ')');
+	return state == nullptr || state[1] == 0 || (state[2] != 'Z' && state[2] != 'X');
+}
+
+// a lock free stack of indices, linked through 'next', the tag in the upper half of 'head' prevents ABA
+struct libsyscall__shared_stack {
+	// (tag << 32) | (top index + 1), the lower half is 0 if the stack is empty
+	std::atomic<uint64_t> head;
+
+	inline void push(std::atomic<uint32_t> * next, uint32_t index) {
+		uint64_t old = head.load(std::memory_order_acquire);
+		for (;;) {
+			next[index].store((uint32_t)old, std::memory_order_relaxed);
+			uint64_t desired = (((old >> 32) + 1) << 32) | (uint64_t)(index + 1);
+			if (head.compare_exchange_weak(old, desired, std::memory_order_release, std::memory_order_acquire)) return;
+		}
+	}
+
+	inline bool pop(std::atomic<uint32_t> * next, uint32_t & index) {
+		uint64_t old = head.load(std::memory_order_acquire);
+		for (;;) {
+			uint32_t top = (uint32_t)old;
+			if (top == 0) return false;
+			uint32_t after = next[top - 1].load(std::memory_order_relaxed);
+			uint64_t desired = (((old >> 32) + 1) << 32) | (uint64_t)after;
+			if (head.compare_exchange_weak(old, desired, std::memory_order_acq_rel, std::memory_order_acquire)) {
+				index = top - 1;
+				return true;
+			}
+		}
+	}
+};
+
+// a global fd
+struct libsyscall__shared_fd {
+	// ((owner + 1) << 32) | local fd, 0 if the global fd is free
+	std::atomic<uint64_t> binding;
+	std::atomic<uint32_t> next;
+};
+
+// a forwarded call, one cell of a request ring
+struct libsyscall__shared_request {
+	std::atomic<uint64_t> sequence;
+	// the global fd and the binding the caller saw, the owner refuses the call if the binding of 'global' has changed since
+	uint64_t binding;
+	uint32_t global;
+	// the generation of the owner the caller saw, so that a process attaching to the same slot refuses the calls meant for the last one
+	uint32_t generation;
+	uint32_t id;
+	uint32_t reply;
+	alignas(8) unsigned char arguments[LIBSYSCALL_RING_ARGUMENT_SIZE];
+};
+
+struct libsyscall__shared_reply {
+	// 0 while the call is in flight, 1 once it has completed, 2 once the caller has given up on it, see 'SyscallShared::complete'
+	std::atomic<uint32_t> state;
+	// set by a caller that is about to sleep on 'state'
+	std::atomic<uint32_t> waiting;
+	std::atomic<uint32_t> next;
+	int32_t error;
+	alignas(8) unsigned char result[LIBSYSCALL_RING_RESULT_SIZE];
+};
+
+// an attached process and the head of its request ring
+struct alignas(64) libsyscall__shared_process {
+	// 0 free, 1 attached, 2 being attached or reaped
+	std::atomic<uint32_t> state;
+	// bumped on every attach and detach
+	std::atomic<uint32_t> generation;
+	std::atomic<int32_t> pid;
+	// bumped by callers that find the owner asleep, the owner sleeps on it
+	std::atomic<uint32_t> doorbell;
+	std::atomic<uint32_t> sleeping;
+	alignas(64) std::atomic<uint64_t> enqueue_position;
+	alignas(64) std::atomic<uint64_t> dequeue_position;
+};
+
+struct alignas(64) libsyscall__shared_header {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t fds;
+	uint32_t processes;
+	uint32_t ring_entries;
+	uint32_t replies;
+	uint64_t size;
+	uint64_t fds_offset;
+	uint64_t processes_offset;
+	uint64_t requests_offset;
+	uint64_t replies_offset;
+	alignas(64) libsyscall__shared_stack free_fds;
+	alignas(64) libsyscall__shared_stack free_replies;
+};
+
+// the shared memory backing a SyscallShared
+//
+// an anonymous segment (a memfd) is shared with the processes forked after it was created,
+//  a named segment (see shm_open) may be opened by unrelated processes
+//
+struct SyscallSharedSegment {
+	inline SyscallSharedSegment(const SyscallSharedOptions & options = SyscallSharedOptions()) {
+		file = memfd_create("libsyscall", MFD_CLOEXEC);
+		if (file == -1) {
+			throw new std::runtime_error("SyscallSharedSegment ERROR: memfd_create failed");
+		}
+		create(options);
+	}
+
+	// creates the named segment 'name' ('/name', see shm_open) if 'create_segment' is true, otherwise opens it
+	inline SyscallSharedSegment(const std::string & name, bool create_segment, const SyscallSharedOptions & options = SyscallSharedOptions()) {
+		file = shm_open(name.c_str(), O_RDWR | (create_segment ? O_CREAT | O_EXCL : 0), 0600);
+		if (file == -1) {
+			std::string msg = "SyscallSharedSegment ERROR: failed to open '" + name + "'";
+			throw new std::runtime_error(msg.c_str());
+		}
+		if (create_segment) {
+			create(options);
+			return;
+		}
+		struct stat st;
+		if (fstat(file, &st) != 0 || (size_t)st.st_size < sizeof(libsyscall__shared_header)) {
+			::close(file);
+			std::string msg = "SyscallSharedSegment ERROR: '" + name + "' is not a libsyscall segment";
+			throw new std::runtime_error(msg.c_str());
+		}
+		map((size_t)st.st_size);
+		if (header()->magic != LIBSYSCALL_SHARED_MAGIC || header()->version != LIBSYSCALL_SHARED_VERSION || header()->size != size) {
+			unmap();
+			std::string msg = "SyscallSharedSegment ERROR: '" + name + "' is not a libsyscall segment";
+			throw new std::runtime_error(msg.c_str());
+		}
+	}
+
+	SyscallSharedSegment(const SyscallSharedSegment &) = delete;
+	SyscallSharedSegment & operator=(const SyscallSharedSegment &) = delete;
+
+	inline ~SyscallSharedSegment() {
+		unmap();
+	}
+
+	// removes the name of a named segment, processes that have it mapped keep using it
+	static inline void unlink(const std::string & name) {
+		shm_unlink(name.c_str());
+	}
+
+	inline libsyscall__shared_header * header() const { return static_cast<libsyscall__shared_header*>(memory); }
+
+	inline libsyscall__shared_fd * fds() const { return reinterpret_cast<libsyscall__shared_fd*>(static_cast<char*>(memory) + header()->fds_offset); }
+
+	inline libsyscall__shared_process * process(uint32_t index) const {
+		return reinterpret_cast<libsyscall__shared_process*>(static_cast<char*>(memory) + header()->processes_offset) + index;
+	}
+
+	inline libsyscall__shared_request * requests(uint32_t process) const {
+		return reinterpret_cast<libsyscall__shared_request*>(static_cast<char*>(memory) + header()->requests_offset) + (size_t)process * header()->ring_entries;
+	}
+
+	inline libsyscall__shared_reply * replies() const { return reinterpret_cast<libsyscall__shared_reply*>(static_cast<char*>(memory) + header()->replies_offset); }
+
+private:
+	int file = -1;
+	void * memory = nullptr;
+	size_t size = 0;
+
+	static inline uint64_t align(uint64_t offset) { return (offset + 63) / 64 * 64; }
+
+	inline void map(size_t bytes) {
+		size = bytes;
+		memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+		if (memory == MAP_FAILED) {
+			memory = nullptr;
+			::close(file);
+			throw new std::runtime_error("SyscallSharedSegment ERROR: mmap failed");
+		}
+	}
+
+	inline void unmap() {
+		if (memory != nullptr) munmap(memory, size);
+		if (file != -1) ::close(file);
+		memory = nullptr;
+		file = -1;
+	}
+
+	inline void create(const SyscallSharedOptions & options) {
+		uint32_t ring_entries = 1;
+		while (ring_entries < options.ring_entries) ring_entries <<= 1;
+		uint64_t fds_offset = align(sizeof(libsyscall__shared_header));
+		uint64_t processes_offset = align(fds_offset + sizeof(libsyscall__shared_fd) * options.fds);
+		uint64_t requests_offset = align(processes_offset + sizeof(libsyscall__shared_process) * options.processes);
+		uint64_t replies_offset = align(requests_offset + sizeof(libsyscall__shared_request) * (uint64_t)ring_entries * options.processes);
+		uint64_t bytes = align(replies_offset + sizeof(libsyscall__shared_reply) * options.replies);
+		if (ftruncate(file, (off_t)bytes) != 0) {
+			::close(file);
+			throw new std::runtime_error("SyscallSharedSegment ERROR: failed to size the segment");
+		}
+		// the pages of a fresh segment are zero, which is the initial state of every atomic in it
+		map((size_t)bytes);
+		libsyscall__shared_header * h = header();
+		h->fds = options.fds;
+		h->processes = options.processes;
+		h->ring_entries = ring_entries;
+		h->replies = options.replies;
+		h->size = bytes;
+		h->fds_offset = fds_offset;
+		h->processes_offset = processes_offset;
+		h->requests_offset = requests_offset;
+		h->replies_offset = replies_offset;
+		// the free stacks start out linked in order, so that the lowest fd's are handed out first
+		for (uint32_t i = 0; i < options.fds; i++) {
+			fds()[i].next.store(i + 1 < options.fds ? i + 2 : 0, std::memory_order_relaxed);
+		}
+		h->free_fds.head.store(options.fds == 0 ? 0 : 1, std::memory_order_relaxed);
+		for (uint32_t i = 0; i < options.replies; i++) {
+			replies()[i].next.store(i + 1 < options.replies ? i + 2 : 0, std::memory_order_relaxed);
+		}
+		h->free_replies.head.store(options.replies == 0 ? 0 : 1, std::memory_order_relaxed);
+		for (uint32_t p = 0; p < options.processes; p++) {
+			for (uint32_t i = 0; i < ring_entries; i++) {
+				requests(p)[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+		h->version = LIBSYSCALL_SHARED_VERSION;
+		std::atomic_thread_fence(std::memory_order_release);
+		h->magic = LIBSYSCALL_SHARED_MAGIC;
+	}
+};
+
+// whether syscall 'S' can be forwarded to another process, see 'SyscallShared'
+template <typename F>
+struct libsyscall__shared_marshal;
+
+template <typename Ret, typename ... Args>
+struct libsyscall__shared_marshal<Ret(*)(int, void*, Args...)> {
+	using layout = libsyscall__argument_layout<typename std::decay<Args>::type...>;
+	using sequence = std::index_sequence_for<Args...>;
+	using result_type = typename std::conditional<std::is_void<Ret>::value, char, Ret>::type;
+
+	static constexpr bool value =
+		(std::is_trivially_copyable<typename std::decay<Args>::type>::value && ...) &&
+		(std::is_default_constructible<typename std::decay<Args>::type>::value && ...) &&
+		layout::size <= LIBSYSCALL_RING_ARGUMENT_SIZE &&
+		std::is_trivially_copyable<result_type>::value && sizeof(result_type) <= LIBSYSCALL_RING_RESULT_SIZE;
+};
+
+template <typename S, typename F = typename S::function_type>
+struct libsyscall__shared_invoker;
+
+template <typename S, typename Ret, typename ... Args>
+struct libsyscall__shared_invoker<S, Ret(*)(int, void*, Args...)> {
+	using marshal = libsyscall__shared_marshal<Ret(*)(int, void*, Args...)>;
+
+	template <typename ... A>
+	static inline void store(unsigned char * buffer, A && ... arguments) {
+		marshal::layout::store(buffer, typename marshal::sequence(), typename std::decay<Args>::type(std::forward<A>(arguments))...);
+	}
+
+	// runs in the owner, returns the error of the call
+	template <typename Table>
+	static int invoke(Table & sys, int fd, const unsigned char * arguments, unsigned char * result) {
+		if constexpr (marshal::value) {
+			auto values = marshal::layout::load(arguments, typename marshal::sequence());
+			SyscallResult<Ret> r = std::apply([&](auto & ... a) { return sys.template try_call<S>(fd, a...); }, values);
+			if constexpr (!std::is_void<Ret>::value) {
+				if (r.ok()) memcpy(result, &*r, sizeof(Ret));
+			}
+			return r.error();
+		}
+		else {
+			return ENOTSUP;
+		}
+	}
+};
+
+template <typename Table>
+struct SyscallShared {
+	// attaches this process to 'segment', throws if every process slot is taken
+	//
+	// the slots of processes that exited without detaching are reaped first
+	inline SyscallShared(Table & sys, SyscallSharedSegment & segment) : sys(sys), segment(segment) {
+		libsyscall__shared_header * h = segment.header();
+		for (uint32_t p = 0; p < h->processes; p++) {
+			reap(p, segment.process(p)->generation.load(std::memory_order_acquire));
+		}
+		for (uint32_t p = 0; p < h->processes; p++) {
+			uint32_t expected = 0;
+			libsyscall__shared_process * process = segment.process(p);
+			if (process->state.compare_exchange_strong(expected, 2, std::memory_order_acq_rel)) {
+				self = p;
+				// calls that were queued after the last process in this slot detached
+				sweep(p, EPIPE);
+				process->pid.store((int32_t)getpid(), std::memory_order_relaxed);
+				generation = process->generation.fetch_add(1, std::memory_order_acq_rel) + 1;
+				process->state.store(1, std::memory_order_release);
+				return;
+			}
+		}
+		throw new std::runtime_error("SyscallShared ERROR: every process slot of the segment is taken");
+	}
+
+	SyscallShared(const SyscallShared &) = delete;
+	SyscallShared & operator=(const SyscallShared &) = delete;
+
+	// unshares every fd this process still shares, and fails the calls still queued for it with EBADF without running them
+	//
+	// 'serve' must have returned on every thread that runs it
+	inline ~SyscallShared() {
+		stop();
+		unshare_all(self);
+		sweep(self, EBADF);
+		libsyscall__shared_process * process = segment.process(self);
+		process->generation.fetch_add(1, std::memory_order_release);
+		process->state.store(0, std::memory_order_release);
+	}
+
+	// the index of this process in the segment
+	inline uint32_t process_index() const { return self; }
+
+	// makes 'fd' of this process visible to every attached process, returns its global fd
+	//
+	// 'fd' stays owned by this process, closing it does not unshare it
+	//
+	inline int share(int fd) {
+		if (!sys.valid(fd)) {
+			std::string msg = "SyscallShared ERROR: fd (" + std::to_string(fd) + ") is invalid";
+			throw new std::runtime_error(msg.c_str());
+		}
+		libsyscall__shared_fd * fds = segment.fds();
+		uint32_t global;
+		if (!segment.header()->free_fds.pop(&fds[0].next, global)) {
+			throw new std::runtime_error("SyscallShared ERROR: the shared fd table is full");
+		}
+		fds[global].binding.store(((uint64_t)(self + 1) << 32) | (uint32_t)fd, std::memory_order_release);
+		return (int)global;
+	}
+
+	// frees the global fd 'global', which must be owned by this process
+	inline void unshare(int global) {
+		uint64_t binding = lookup(global);
+		if (binding == 0 || owner_of(binding) != self) {
+			std::string msg = "SyscallShared ERROR: global fd (" + std::to_string(global) + ") is not shared by this process";
+			throw new std::runtime_error(msg.c_str());
+		}
+		libsyscall__shared_fd * fds = segment.fds();
+		fds[global].binding.store(0, std::memory_order_release);
+		segment.header()->free_fds.push(&fds[0].next, (uint32_t)global);
+	}
+
+	// the owner and local fd of 'global', returns false if it is not shared
+	inline bool resolve(int global, uint32_t * owner, int * fd) const {
+		uint64_t binding = lookup(global);
+		if (binding == 0) return false;
+		*owner = owner_of(binding);
+		*fd = local_of(binding);
+		return true;
+	}
+
+	// invoke syscall 'S' on the global fd 'global', see 'SYSCALLS::try_call'
+	//
+	// a call forwarded to another process may additionally fail with ENOTSUP or EPIPE
+	//
+	template <typename S, typename ... Args>
+	inline SyscallResult<typename S::return_type> try_call(int global, Args && ... args) {
+		using R = typename S::return_type;
+		uint64_t binding = lookup(global);
+		if (binding == 0) return SyscallResult<R>::failure(EBADF);
+		if (owner_of(binding) == self) return sys.template try_call<S>(local_of(binding), std::forward<Args>(args)...);
+		if constexpr (!libsyscall__shared_invoker<S>::marshal::value) {
+			return SyscallResult<R>::failure(ENOTSUP);
+		}
+		else {
+			return forward<S>(global, binding, std::forward<Args>(args)...);
+		}
+	}
+
+	// invoke syscall 'S' on the global fd 'global', see 'SYSCALLS::call'
+	template <typename S, typename ... Args>
+	inline typename S::return_type call(int global, Args && ... args) {
+		using R = typename S::return_type;
+		uint64_t binding = lookup(global);
+		if (binding != 0 && owner_of(binding) == self) return sys.template call<S>(local_of(binding), std::forward<Args>(args)...);
+		SyscallResult<R> r = try_call<S>(global, std::forward<Args>(args)...);
+		if (r.error() == EBADF) {
+			std::string msg = "SYSCALL_BASE ERROR: fd (" + std::to_string(global) + ") is invalid";
+			throw new std::runtime_error(msg.c_str());
+		}
+		if (r.error() == ENOSYS) throw new std::runtime_error("callback not supported");
+		if (!r.ok()) {
+			std::string msg = "SYSCALL_BASE ERROR: syscall was rejected with error " + std::to_string(r.error());
+			throw new std::runtime_error(msg.c_str());
+		}
+		if constexpr (!std::is_void<R>::value) return std::move(*r);
+	}
+
+	// runs every call queued for this process, returns how many were run
+	inline size_t serve_pending() {
+		return drain(self, [this](const libsyscall__shared_request & request, libsyscall__shared_reply & reply) { execute(request, reply); });
+	}
+
+	// serves calls until 'stop' is called, on as many threads as needed
+	inline void serve() {
+		libsyscall__shared_process * process = segment.process(self);
+		while (!stopping.load(std::memory_order_acquire)) {
+			if (serve_pending() != 0) continue;
+			// spin for a little while, a sleeping owner costs the caller a futex wake
+			bool found = false;
+			for (int spin = 0; spin < 2000 && !found; spin++) {
+				found = !empty();
+			}
+			if (found) continue;
+			uint32_t bell = process->doorbell.load(std::memory_order_acquire);
+			process->sleeping.fetch_add(1, std::memory_order_seq_cst);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (empty() && !stopping.load(std::memory_order_acquire)) {
+				libsyscall__shared_futex_wait(&process->doorbell, bell, 100);
+			}
+			process->sleeping.fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+
+	// makes 'serve' return
+	inline void stop() {
+		libsyscall__shared_process * process = segment.process(self);
+		stopping.store(true, std::memory_order_release);
+		process->doorbell.fetch_add(1, std::memory_order_release);
+		libsyscall__shared_futex_wake(&process->doorbell);
+	}
+
+private:
+	Table & sys;
+	SyscallSharedSegment & segment;
+	uint32_t self = 0;
+	// the generation of our slot while we are attached to it
+	uint32_t generation = 0;
+	std::atomic<bool> stopping = { false };
+
+	using invoke_function = int (*)(Table & sys, int fd, const unsigned char * arguments, unsigned char * result);
+
+	static inline uint32_t owner_of(uint64_t binding) { return (uint32_t)(binding >> 32) - 1; }
+
+	static inline int local_of(uint64_t binding) { return (int)(uint32_t)binding; }
+
+	inline uint64_t lookup(int global) const {
+		if (global < 0 || (uint32_t)global >= segment.header()->fds) return 0;
+		return segment.fds()[global].binding.load(std::memory_order_acquire);
+	}
+
+	inline bool empty() const {
+		libsyscall__shared_process * process = segment.process(self);
+		uint64_t position = process->dequeue_position.load(std::memory_order_relaxed);
+		libsyscall__shared_request & cell = segment.requests(self)[position & (segment.header()->ring_entries - 1)];
+		return (int64_t)cell.sequence.load(std::memory_order_acquire) - (int64_t)(position + 1) < 0;
+	}
+
+	template <typename ... Syscalls>
+	static inline const invoke_function * dispatch_of(libsyscall__syscall_list<Syscalls...>) {
+		static const invoke_function table[] = { &libsyscall__shared_invoker<Syscalls>::template invoke<Table>..., nullptr };
+		return table;
+	}
+
+	static inline const invoke_function * dispatch() {
+		return dispatch_of(libsyscall__syscalls_of<Table>());
+	}
+
+	// dequeues every call queued for 'process' and passes it to 'handle' along with its reply slot, returns how many there were
+	//
+	// 'handle' receives a copy of the request, its cell is handed back to the callers first
+	template <typename Handle>
+	inline size_t drain(uint32_t process_index, Handle handle) {
+		libsyscall__shared_process * process = segment.process(process_index);
+		libsyscall__shared_request * cells = segment.requests(process_index);
+		uint64_t mask = segment.header()->ring_entries - 1;
+		size_t drained = 0;
+		for (;;) {
+			uint64_t position = process->dequeue_position.load(std::memory_order_relaxed);
+			libsyscall__shared_request & cell = cells[position & mask];
+			int64_t difference = (int64_t)cell.sequence.load(std::memory_order_acquire) - (int64_t)(position + 1);
+			if (difference < 0) return drained;
+			if (difference > 0 || !process->dequeue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) continue;
+			libsyscall__shared_request request;
+			request.binding = cell.binding;
+			request.global = cell.global;
+			request.generation = cell.generation;
+			request.id = cell.id;
+			request.reply = cell.reply;
+			memcpy(request.arguments, cell.arguments, sizeof(request.arguments));
+			cell.sequence.store(position + mask + 1, std::memory_order_release);
+			handle(request, segment.replies()[request.reply]);
+			drained++;
+		}
+	}
+
+	// fails every call queued for 'process' with 'error' without running it
+	inline size_t sweep(uint32_t process_index, int error) {
+		return drain(process_index, [this, error](const libsyscall__shared_request &, libsyscall__shared_reply & reply) { complete(reply, error); });
+	}
+
+	// unshares every global fd owned by 'process'
+	inline void unshare_all(uint32_t process_index) {
+		libsyscall__shared_header * h = segment.header();
+		libsyscall__shared_fd * fds = segment.fds();
+		for (uint32_t i = 0; i < h->fds; i++) {
+			uint64_t binding = fds[i].binding.load(std::memory_order_acquire);
+			if (binding == 0 || owner_of(binding) != process_index) continue;
+			if (fds[i].binding.compare_exchange_strong(binding, 0, std::memory_order_acq_rel)) h->free_fds.push(&fds[0].next, i);
+		}
+	}
+
+	// frees the slot of 'process' if it is still at 'seen' and its process exited without detaching, see 'SyscallShared'
+	inline void reap(uint32_t process_index, uint32_t seen) {
+		libsyscall__shared_process * process = segment.process(process_index);
+		if (process->state.load(std::memory_order_acquire) != 1 || libsyscall__shared_alive(process->pid.load(std::memory_order_relaxed))) return;
+		uint32_t expected = 1;
+		if (!process->state.compare_exchange_strong(expected, 2, std::memory_order_acq_rel)) return;
+		if (process->generation.load(std::memory_order_acquire) != seen) {
+			// another process reaped the slot and attached to it in the meantime
+			process->state.store(1, std::memory_order_release);
+			return;
+		}
+		unshare_all(process_index);
+		sweep(process_index, EPIPE);
+		process->generation.fetch_add(1, std::memory_order_release);
+		process->state.store(0, std::memory_order_release);
+	}
+
+	// true once the owner a call was meant for has detached or exited, an owner that exited is reaped
+	inline bool gone(uint32_t owner, uint32_t seen) {
+		libsyscall__shared_process * process = segment.process(owner);
+		if (process->generation.load(std::memory_order_acquire) != seen || process->state.load(std::memory_order_acquire) != 1) return true;
+		if (libsyscall__shared_alive(process->pid.load(std::memory_order_relaxed))) return false;
+		reap(owner, seen);
+		return true;
+	}
+
+	// hands the result in 'reply' to its caller, or returns the slot to the pool if the caller has given up on it
+	inline void complete(libsyscall__shared_reply & reply, int error) {
+		reply.error = error;
+		uint32_t expected = 0;
+		if (!reply.state.compare_exchange_strong(expected, 1, std::memory_order_seq_cst)) {
+			segment.header()->free_replies.push(&segment.replies()[0].next, (uint32_t)(&reply - segment.replies()));
+			return;
+		}
+		if (reply.waiting.load(std::memory_order_seq_cst) != 0) {
+			libsyscall__shared_futex_wake(&reply.state);
+		}
+	}
+
+	inline void execute(const libsyscall__shared_request & request, libsyscall__shared_reply & reply) {
+		int error;
+		// the fd may have been unshared (and its global fd reused) after the caller looked it up,
+		//  and the call may have been meant for the process that had our slot before us
+		if (request.id >= Table::count) error = ENOSYS;
+		else if (request.generation != generation || lookup((int)request.global) != request.binding || owner_of(request.binding) != self) error = EBADF;
+		else {
+			try {
+				error = dispatch()[request.id](sys, local_of(request.binding), request.arguments, reply.result);
+			}
+			catch (...) {
+				error = EIO;
+			}
+		}
+		complete(reply, error);
+	}
+
+	// how many times the wait loops of 'forward' yield between checks of the owner, see 'gone'
+	static constexpr uint32_t owner_check_interval = 64;
+
+	template <typename S, typename ... Args>
+	inline SyscallResult<typename S::return_type> forward(int global, uint64_t binding, Args && ... args) {
+		using R = typename S::return_type;
+		uint32_t owner = owner_of(binding);
+		libsyscall__shared_header * h = segment.header();
+		libsyscall__shared_process * process = segment.process(owner);
+		uint32_t seen = process->generation.load(std::memory_order_acquire);
+		if (process->state.load(std::memory_order_acquire) != 1) return SyscallResult<R>::failure(EPIPE);
+
+		// the pool only runs dry while calls are in flight, which complete unless their owners are gone
+		uint32_t reply_index;
+		for (uint32_t spin = 1; !h->free_replies.pop(&segment.replies()[0].next, reply_index); spin++) {
+			std::this_thread::yield();
+			if (spin % owner_check_interval == 0 && gone(owner, seen)) return SyscallResult<R>::failure(EPIPE);
+		}
+		libsyscall__shared_reply & reply = segment.replies()[reply_index];
+		reply.state.store(0, std::memory_order_relaxed);
+		reply.waiting.store(0, std::memory_order_relaxed);
+
+		libsyscall__shared_request * cells = segment.requests(owner);
+		uint64_t mask = h->ring_entries - 1;
+		uint64_t position = process->enqueue_position.load(std::memory_order_relaxed);
+		libsyscall__shared_request * cell;
+		for (uint32_t spin = 1;;) {
+			cell = &cells[position & mask];
+			int64_t difference = (int64_t)cell->sequence.load(std::memory_order_acquire) - (int64_t)position;
+			if (difference == 0) {
+				if (process->enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+			}
+			else if (difference < 0) {
+				// the owner's ring is full, the reply slot is still ours to return
+				std::this_thread::yield();
+				if (spin++ % owner_check_interval == 0 && gone(owner, seen)) {
+					h->free_replies.push(&segment.replies()[0].next, reply_index);
+					return SyscallResult<R>::failure(EPIPE);
+				}
+				position = process->enqueue_position.load(std::memory_order_relaxed);
+			}
+			else {
+				position = process->enqueue_position.load(std::memory_order_relaxed);
+			}
+		}
+		cell->binding = binding;
+		cell->global = (uint32_t)global;
+		cell->generation = seen;
+		cell->id = (uint32_t)Table::template id<S>;
+		cell->reply = reply_index;
+		libsyscall__shared_invoker<S>::store(cell->arguments, std::forward<Args>(args)...);
+		cell->sequence.store(position + 1, std::memory_order_release);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (process->sleeping.load(std::memory_order_seq_cst) != 0) {
+			process->doorbell.fetch_add(1, std::memory_order_release);
+			libsyscall__shared_futex_wake(&process->doorbell);
+		}
+
+		if (!wait(reply, owner, seen)) {
+			// the call may still be completed by the owner or swept when its slot is reaped or attached to again,
+			//  whoever does that returns the reply slot, unless the call completed right now
+			uint32_t expected = 0;
+			if (reply.state.compare_exchange_strong(expected, 2, std::memory_order_seq_cst)) return SyscallResult<R>::failure(EPIPE);
+		}
+		int error = reply.error;
+		SyscallResult<R> result = SyscallResult<R>::failure(error);
+		if (error == 0) {
+			if constexpr (std::is_void<R>::value) {
+				result = SyscallResult<R>();
+			}
+			else {
+				R value;
+				memcpy(&value, reply.result, sizeof(R));
+				result = SyscallResult<R>(value);
+			}
+		}
+		h->free_replies.push(&segment.replies()[0].next, reply_index);
+		return result;
+	}
+
+	// returns false if the owner went away without replying
+	inline bool wait(libsyscall__shared_reply & reply, uint32_t owner, uint32_t seen) {
+		for (int spin = 0; spin < 2000; spin++) {
+			if (reply.state.load(std::memory_order_acquire) != 0) return true;
+		}
+		reply.waiting.store(1, std::memory_order_seq_cst);
+		for (;;) {
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (reply.state.load(std::memory_order_acquire) != 0) return true;
+			libsyscall__shared_futex_wait(&reply.state, 0, 100);
+			if (reply.state.load(std::memory_order_acquire) != 0) return true;
+			if (gone(owner, seen)) return reply.state.load(std::memory_order_acquire) != 0;
+		}
+	}
+};
+
+#endif // LIBSYSCALL_SYSCALL_SHARED_H
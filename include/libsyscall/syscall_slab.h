@@ -0,0 +1,341 @@
+#ifndef LIBSYSCALL_SYSCALL_SLAB_H
+#define LIBSYSCALL_SYSCALL_SLAB_H
+
+// per provider pools of resource objects, see 'SyscallProvider::make_resource'
+//
+// this is included by libsyscall.h, and is not meant to be included directly
+//
+// every type a provider makes resources of gets a pool of fixed size blocks, carved out of chunks
+//  that double in size up to LIBSYSCALL_SLAB_MAX_CHUNK blocks
+//
+// every thread keeps a small cache of free blocks per pool, so making and releasing a resource usually takes no lock,
+//  a block released on another thread than the one it was made on simply joins the releasing thread's cache,
+//  a thread that exits returns its caches to their pools, and forgets the caches of pools that went away before it
+//
+// a pool lives as long as its provider, destroying it destroys every object still alive in it and frees its chunks in one go
+//
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <new>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+// the number of free blocks a thread keeps per pool, half of them are returned to the pool when it overflows
+#ifndef LIBSYSCALL_SLAB_CACHE
+#define LIBSYSCALL_SLAB_CACHE 32
+#endif
+
+// the largest chunk a pool allocates, in blocks
+#ifndef LIBSYSCALL_SLAB_MAX_CHUNK
+#define LIBSYSCALL_SLAB_MAX_CHUNK 4096
+#endif
+
+struct libsyscall__slab;
+
+// precedes the object in every block
+struct alignas(16) libsyscall__slab_header {
+	libsyscall__slab * slab;
+	// 1 while the block holds a live object
+	uint32_t live;
+};
+
+// a unique address per type, identifies the pool of a type
+template <typename T>
+struct libsyscall__slab_type {
+	static constexpr char tag = 0;
+};
+
+// the offset of the object from the start of its block
+template <typename T>
+constexpr size_t libsyscall__slab_offset() {
+	return alignof(T) > sizeof(libsyscall__slab_header) ? alignof(T) : sizeof(libsyscall__slab_header);
+}
+
+// the free blocks a single thread holds on to, only ever touched by that thread
+//
+// owned by its thread, its pool lists it until either of the two goes away, see 'libsyscall__slab_thread'
+struct libsyscall__slab_cache {
+	size_t count = 0;
+	libsyscall__slab_header * blocks[LIBSYSCALL_SLAB_CACHE];
+	// nullptr once the pool is gone
+	std::atomic<libsyscall__slab*> slab = { nullptr };
+};
+
+// guards the unlisting of a cache by its pool or its thread, never destroyed so that pools destroyed at exit can still take it
+inline std::mutex & libsyscall__slab_handover() {
+	static std::mutex * mutex = new std::mutex();
+	return *mutex;
+}
+
+// the caches of one thread, returned to their pools when the thread exits
+struct libsyscall__slab_thread {
+	std::vector<libsyscall__slab_cache*> caches;
+
+	inline ~libsyscall__slab_thread();
+
+	// forgets the caches of pools that went away, the caller is about to add one
+	inline void prune() {
+		caches.erase(std::remove_if(caches.begin(), caches.end(), [](libsyscall__slab_cache * cache) {
+			if (cache->slab.load(std::memory_order_acquire) != nullptr) return false;
+			std::lock_guard<std::mutex> lock(libsyscall__slab_handover());
+			delete cache;
+			return true;
+		}), caches.end());
+	}
+};
+
+template <typename T>
+inline void (*libsyscall__slab_relocate(std::true_type))(void *, void *) {
+	return [](void * from, void * to) {
+		T * object = static_cast<T*>(from);
+		new (to) T(std::move(*object));
+		object->~T();
+	};
+}
+
+template <typename T>
+inline void (*libsyscall__slab_relocate(std::false_type))(void *, void *) {
+	return nullptr;
+}
+
+struct libsyscall__slab {
+	const void * type;
+	size_t object_offset;
+	size_t block_size;
+	size_t alignment;
+	// nullptr if the type is trivially destructible
+	void (*destroy)(void * object);
+	// move constructs the object at 'to' from the one at 'from' and destroys the latter, nullptr if the type is not move constructible
+	void (*relocate)(void * from, void * to);
+	// creates an empty pool of the same type, see 'libsyscall__slabs::of'
+	libsyscall__slab * (*create_like)();
+	// the next pool of the same provider
+	libsyscall__slab * next = nullptr;
+
+	struct Chunk {
+		char * begin;
+		char * end;
+	};
+
+	std::mutex mutex;
+	// sorted by address, see 'owns'
+	std::vector<Chunk> chunks;
+	std::vector<libsyscall__slab_header*> free_blocks;
+	size_t next_chunk_blocks = 64;
+	std::vector<libsyscall__slab_cache*> caches;
+
+	template <typename T>
+	static inline libsyscall__slab * create() {
+		libsyscall__slab * slab = new libsyscall__slab();
+		slab->type = &libsyscall__slab_type<T>::tag;
+		slab->alignment = std::max(alignof(T), alignof(libsyscall__slab_header));
+		slab->object_offset = libsyscall__slab_offset<T>();
+		slab->block_size = (slab->object_offset + sizeof(T) + slab->alignment - 1) / slab->alignment * slab->alignment;
+		slab->destroy = std::is_trivially_destructible<T>::value ? nullptr : +[](void * object) { static_cast<T*>(object)->~T(); };
+		slab->relocate = libsyscall__slab_relocate<T>(std::is_move_constructible<T>());
+		slab->create_like = &create<T>;
+		return slab;
+	}
+
+	// destroys every object that is still alive, then frees every chunk, and tells the threads of its caches that it is gone
+	inline ~libsyscall__slab() {
+		{
+			std::lock_guard<std::mutex> lock(libsyscall__slab_handover());
+			for (libsyscall__slab_cache * cache : caches) {
+				cache->slab.store(nullptr, std::memory_order_release);
+			}
+		}
+		for (const Chunk & chunk : chunks) {
+			if (destroy != nullptr) {
+				for (char * block = chunk.begin; block < chunk.end; block += block_size) {
+					libsyscall__slab_header * header = reinterpret_cast<libsyscall__slab_header*>(block);
+					if (header->live) destroy(block + object_offset);
+				}
+			}
+			::operator delete(chunk.begin, std::align_val_t(alignment));
+		}
+	}
+
+	inline libsyscall__slab_cache & local() {
+		static thread_local libsyscall__slab_thread thread;
+		for (libsyscall__slab_cache * cache : thread.caches) {
+			if (cache->slab.load(std::memory_order_acquire) == this) return *cache;
+		}
+		thread.prune();
+		libsyscall__slab_cache * cache = new libsyscall__slab_cache();
+		cache->slab.store(this, std::memory_order_relaxed);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			caches.push_back(cache);
+		}
+		thread.caches.push_back(cache);
+		return *cache;
+	}
+
+	// returns the blocks of 'cache' to the pool and unlists it, for a thread that exits
+	inline void drain(libsyscall__slab_cache & cache) {
+		std::lock_guard<std::mutex> lock(mutex);
+		while (cache.count != 0) free_blocks.push_back(cache.blocks[--cache.count]);
+		caches.erase(std::find(caches.begin(), caches.end(), &cache));
+	}
+
+	// the caller must hold 'mutex'
+	inline void grow() {
+		size_t blocks = next_chunk_blocks;
+		if (next_chunk_blocks < LIBSYSCALL_SLAB_MAX_CHUNK) next_chunk_blocks *= 2;
+		char * begin = static_cast<char*>(::operator new(blocks * block_size, std::align_val_t(alignment)));
+		Chunk chunk = { begin, begin + blocks * block_size };
+		chunks.insert(std::upper_bound(chunks.begin(), chunks.end(), chunk, [](const Chunk & a, const Chunk & b) {
+			return std::less<char*>()(a.begin, b.begin);
+		}), chunk);
+		// pushed in reverse so that the lowest addresses are handed out first
+		for (size_t i = blocks; i-- != 0;) {
+			libsyscall__slab_header * header = reinterpret_cast<libsyscall__slab_header*>(begin + i * block_size);
+			header->slab = this;
+			header->live = 0;
+			free_blocks.push_back(header);
+		}
+	}
+
+	// returns uninitialized memory for one object
+	inline void * acquire() {
+		libsyscall__slab_cache & cache = local();
+		if (cache.count == 0) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (free_blocks.empty()) grow();
+			size_t take = std::min(free_blocks.size(), (size_t)LIBSYSCALL_SLAB_CACHE / 2);
+			for (size_t i = 0; i < take; i++) {
+				cache.blocks[cache.count++] = free_blocks.back();
+				free_blocks.pop_back();
+			}
+		}
+		libsyscall__slab_header * header = cache.blocks[--cache.count];
+		header->live = 1;
+		return reinterpret_cast<char*>(header) + object_offset;
+	}
+
+	// returns the block of 'object' without destroying it, for an object whose constructor threw
+	inline void abandon(void * object) {
+		libsyscall__slab_header * header = reinterpret_cast<libsyscall__slab_header*>(static_cast<char*>(object) - object_offset);
+		header->live = 0;
+		libsyscall__slab_cache & cache = local();
+		if (cache.count == LIBSYSCALL_SLAB_CACHE) {
+			std::lock_guard<std::mutex> lock(mutex);
+			for (size_t i = 0; i < LIBSYSCALL_SLAB_CACHE / 2; i++) {
+				free_blocks.push_back(cache.blocks[--cache.count]);
+			}
+		}
+		cache.blocks[cache.count++] = header;
+	}
+
+	// destroys 'object' and returns its block, does nothing if it is not alive
+	inline void release(void * object) {
+		libsyscall__slab_header * header = reinterpret_cast<libsyscall__slab_header*>(static_cast<char*>(object) - object_offset);
+		if (!header->live) return;
+		if (destroy != nullptr) destroy(object);
+		abandon(object);
+	}
+
+	// destroys 'object' without returning its block, for a pool that is about to be destroyed
+	//
+	// takes no lock and touches no cache, so any number of threads may retire objects at once
+	inline void retire(void * object) {
+		libsyscall__slab_header * header = reinterpret_cast<libsyscall__slab_header*>(static_cast<char*>(object) - object_offset);
+		if (!header->live) return;
+		if (destroy != nullptr) destroy(object);
+		header->live = 0;
+	}
+
+	// true if 'pointer' is the object of one of this pool's blocks
+	inline bool owns(const void * pointer) {
+		const char * p = static_cast<const char*>(pointer);
+		std::lock_guard<std::mutex> lock(mutex);
+		auto after = std::upper_bound(chunks.begin(), chunks.end(), p, [](const char * value, const Chunk & chunk) {
+			return std::less<const char*>()(value, chunk.begin);
+		});
+		if (after == chunks.begin()) return false;
+		const Chunk & chunk = *(after - 1);
+		if (!std::less<const char*>()(p, chunk.end)) return false;
+		return (size_t)(p - chunk.begin) % block_size == object_offset;
+	}
+};
+
+inline libsyscall__slab_thread::~libsyscall__slab_thread() {
+	std::lock_guard<std::mutex> lock(libsyscall__slab_handover());
+	for (libsyscall__slab_cache * cache : caches) {
+		libsyscall__slab * slab = cache->slab.load(std::memory_order_acquire);
+		if (slab != nullptr) slab->drain(*cache);
+		delete cache;
+	}
+}
+
+// the pools of one provider, a list that only grows, so lookups take no lock
+struct libsyscall__slabs {
+	std::atomic<libsyscall__slab*> head = { nullptr };
+	std::mutex mutex;
+
+	inline libsyscall__slabs() {}
+
+	libsyscall__slabs(const libsyscall__slabs &) = delete;
+	libsyscall__slabs & operator=(const libsyscall__slabs &) = delete;
+
+	inline ~libsyscall__slabs() {
+		libsyscall__slab * slab = head.load(std::memory_order_relaxed);
+		while (slab != nullptr) {
+			libsyscall__slab * next = slab->next;
+			delete slab;
+			slab = next;
+		}
+	}
+
+	template <typename T>
+	inline libsyscall__slab & of() {
+		return of(&libsyscall__slab_type<T>::tag, &libsyscall__slab::create<T>);
+	}
+
+	// the pool of the same type as 'other', which may belong to another provider
+	inline libsyscall__slab & like(const libsyscall__slab & other) {
+		return of(other.type, other.create_like);
+	}
+
+	inline libsyscall__slab & of(const void * type, libsyscall__slab * (*create)()) {
+		for (libsyscall__slab * slab = head.load(std::memory_order_acquire); slab != nullptr; slab = slab->next) {
+			if (slab->type == type) return *slab;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		for (libsyscall__slab * slab = head.load(std::memory_order_relaxed); slab != nullptr; slab = slab->next) {
+			if (slab->type == type) return *slab;
+		}
+		libsyscall__slab * slab = create();
+		slab->next = head.load(std::memory_order_relaxed);
+		head.store(slab, std::memory_order_release);
+		return *slab;
+	}
+
+	// the pool 'resource' was made in, nullptr if it was not made by one of these pools
+	//
+	// searches every pool, see 'of_resource' for a resource that is known to come from one
+	inline libsyscall__slab * owner(const void * resource) {
+		if (resource == nullptr) return nullptr;
+		for (libsyscall__slab * slab = head.load(std::memory_order_acquire); slab != nullptr; slab = slab->next) {
+			if (slab->owns(resource)) return slab;
+		}
+		return nullptr;
+	}
+
+	// the pool of a 'T' made by 'make_resource', nullptr if it was made by another provider's pool
+	template <typename T>
+	inline libsyscall__slab * of_resource(const T * resource) {
+		libsyscall__slab & slab = of<T>();
+		const libsyscall__slab_header * header = reinterpret_cast<const libsyscall__slab_header*>(reinterpret_cast<const char*>(resource) - slab.object_offset);
+		return header->slab == &slab ? &slab : nullptr;
+	}
+};
+
+#endif // LIBSYSCALL_SYSCALL_SLAB_H
@@ -0,0 +1,331 @@
+#ifndef LIBSYSCALL_SYSCALL_STATS_H
+#define LIBSYSCALL_SYSCALL_STATS_H
+
+// per syscall call counters and latency histograms, 'strace -c' for libsyscall
+//
+// this is included by libsyscall.h when LIBSYSCALL_STATS is 1, and is not meant to be included directly
+//
+// every (provider, syscall) pair gets a call count, an error count and a log-linear latency histogram
+//
+// counters are sharded per thread, a thread only ever writes to its own shard,
+//  'stats_snapshot' merges all shards, 'stats_reset' records a baseline that later snapshots are relative to
+//
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <exception>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// providers with an index at or above this are not counted
+#ifndef LIBSYSCALL_STATS_MAX_PROVIDERS
+#define LIBSYSCALL_STATS_MAX_PROVIDERS 256
+#endif
+
+// the histogram has 4 linear sub-buckets per power of two of nanoseconds, up to 2^40 ns (about 18 minutes)
+#define LIBSYSCALL_STATS_BUCKETS 160
+
+// the name of type 'T', as spelled by the compiler
+template <typename T>
+inline const char * libsyscall__type_name() {
+	// read here rather than inside the lambda, which has a signature of its own
+#if defined(_MSC_VER)
+	const char * signature = __FUNCSIG__;
+#else
+	const char * signature = __PRETTY_FUNCTION__;
+#endif
+	static const std::string name = [](const std::string & signature) {
+#if defined(_MSC_VER)
+		size_t begin = signature.find("libsyscall__type_name<") + 22;
+		size_t end = signature.rfind(">(");
+		std::string type = signature.substr(begin, end - begin);
+		for (const char * prefix : { "struct ", "class " }) {
+			if (type.compare(0, strlen(prefix), prefix) == 0) type = type.substr(strlen(prefix));
+		}
+		return type;
+#else
+		size_t begin = signature.find("T = ") + 4;
+		size_t end = signature.find_first_of(";]", begin);
+		return signature.substr(begin, end - begin);
+#endif
+	}(signature);
+	return name.c_str();
+}
+
+inline size_t libsyscall__stats_bucket(uint64_t ns) {
+	if (ns < 4) return (size_t)ns;
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanReverse64(&index, ns);
+	size_t msb = (size_t)index;
+#else
+	size_t msb = 63 - (size_t)__builtin_clzll(ns);
+#endif
+	size_t bucket = msb * 4 + (size_t)((ns >> (msb - 2)) & 3) - 4;
+	return bucket < LIBSYSCALL_STATS_BUCKETS ? bucket : LIBSYSCALL_STATS_BUCKETS - 1;
+}
+
+// the smallest value that falls into 'bucket'
+inline uint64_t libsyscall__stats_bucket_floor(size_t bucket) {
+	if (bucket < 4) return bucket;
+	size_t msb = bucket / 4 + 1;
+	return (uint64_t)(4 + bucket % 4) << (msb - 2);
+}
+
+// written by a single thread, read by any
+struct libsyscall__stats_counter {
+	std::atomic<uint64_t> calls = { 0 };
+	std::atomic<uint64_t> errors = { 0 };
+	std::atomic<uint64_t> total_ns = { 0 };
+	std::atomic<uint64_t> buckets[LIBSYSCALL_STATS_BUCKETS] = {};
+
+	static inline void bump(std::atomic<uint64_t> & value, uint64_t by) {
+		value.store(value.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+	}
+};
+
+// the counters of one thread, one row of counters per provider
+struct libsyscall__stats_shard {
+	size_t syscall_count;
+	std::atomic<libsyscall__stats_counter*> rows[LIBSYSCALL_STATS_MAX_PROVIDERS] = {};
+
+	inline libsyscall__stats_shard(size_t syscall_count) : syscall_count(syscall_count) {}
+
+	inline ~libsyscall__stats_shard() {
+		for (auto & row : rows) {
+			delete[] row.load(std::memory_order_relaxed);
+		}
+	}
+
+	inline libsyscall__stats_counter * row(size_t provider) {
+		libsyscall__stats_counter * r = rows[provider].load(std::memory_order_relaxed);
+		if (r == nullptr) {
+			r = new libsyscall__stats_counter[syscall_count];
+			rows[provider].store(r, std::memory_order_release);
+		}
+		return r;
+	}
+};
+
+// merged counters of one (provider, syscall) pair
+struct SyscallStatsEntry {
+	size_t provider;
+	size_t syscall;
+	const char * name;
+	uint64_t calls;
+	uint64_t errors;
+	uint64_t total_ns;
+	uint64_t buckets[LIBSYSCALL_STATS_BUCKETS];
+
+	// an approximation of the 'p'th percentile latency (0 - 100) in nanoseconds, the lower bound of its bucket
+	inline uint64_t percentile(double p) const {
+		if (calls == 0) return 0;
+		uint64_t rank = (uint64_t)(p / 100.0 * (double)(calls - 1));
+		uint64_t seen = 0;
+		for (size_t b = 0; b < LIBSYSCALL_STATS_BUCKETS; b++) {
+			seen += buckets[b];
+			if (seen > rank) return libsyscall__stats_bucket_floor(b);
+		}
+		return libsyscall__stats_bucket_floor(LIBSYSCALL_STATS_BUCKETS - 1);
+	}
+};
+
+// the ids of the live 'libsyscall__stats', in ascending order, so that threads can drop the shards of the ones that went away
+//
+// never destroyed, so that instances destroyed at exit can still use it
+struct libsyscall__stats_registry {
+	std::mutex mutex;
+	std::vector<uint64_t> live;
+
+	static inline libsyscall__stats_registry & instance() {
+		static libsyscall__stats_registry * registry = new libsyscall__stats_registry();
+		return *registry;
+	}
+};
+
+struct libsyscall__stats {
+	// unique across all instances, so that a thread's cached shard of a destroyed instance is never mistaken for a new one
+	uint64_t id;
+	size_t syscall_count;
+	const char * const * names = nullptr;
+
+	std::mutex mutex;
+	std::vector<std::unique_ptr<libsyscall__stats_shard>> shards;
+	std::vector<SyscallStatsEntry> baseline;
+
+	static inline uint64_t next_id() {
+		static std::atomic<uint64_t> ids = { 0 };
+		return ids.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	inline libsyscall__stats(size_t syscall_count) : syscall_count(syscall_count) {
+		libsyscall__stats_registry & registry = libsyscall__stats_registry::instance();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		// taken under the lock so that 'live' stays sorted
+		id = next_id();
+		registry.live.push_back(id);
+	}
+
+	inline ~libsyscall__stats() {
+		libsyscall__stats_registry & registry = libsyscall__stats_registry::instance();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		registry.live.erase(std::lower_bound(registry.live.begin(), registry.live.end(), id));
+	}
+
+	inline libsyscall__stats_shard & local() {
+		struct Cached {
+			uint64_t id;
+			libsyscall__stats_shard * shard;
+		};
+		static thread_local std::vector<Cached> cache;
+		for (const Cached & c : cache) {
+			if (c.id == id) return *c.shard;
+		}
+		// a miss is rare, so this is where the shards of instances that went away are forgotten, they were freed along with them
+		{
+			libsyscall__stats_registry & registry = libsyscall__stats_registry::instance();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+			cache.erase(std::remove_if(cache.begin(), cache.end(), [&](const Cached & c) {
+				return !std::binary_search(registry.live.begin(), registry.live.end(), c.id);
+			}), cache.end());
+		}
+		libsyscall__stats_shard * shard = new libsyscall__stats_shard(syscall_count);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			shards.emplace_back(shard);
+		}
+		cache.push_back({ id, shard });
+		return *shard;
+	}
+
+	inline void record(size_t provider, size_t syscall, uint64_t ns, bool error) {
+		if (provider >= LIBSYSCALL_STATS_MAX_PROVIDERS) return;
+		libsyscall__stats_counter & c = local().row(provider)[syscall];
+		libsyscall__stats_counter::bump(c.calls, 1);
+		if (error) libsyscall__stats_counter::bump(c.errors, 1);
+		libsyscall__stats_counter::bump(c.total_ns, ns);
+		libsyscall__stats_counter::bump(c.buckets[libsyscall__stats_bucket(ns)], 1);
+	}
+
+	// the merged totals since the instance was created, every pair that was called at least once
+	inline std::vector<SyscallStatsEntry> totals() {
+		std::vector<SyscallStatsEntry> merged;
+		for (size_t p = 0; p < LIBSYSCALL_STATS_MAX_PROVIDERS; p++) {
+			for (const auto & shard : shards) {
+				libsyscall__stats_counter * row = shard->rows[p].load(std::memory_order_acquire);
+				if (row == nullptr) continue;
+				if (merged.empty() || merged.back().provider != p) {
+					size_t first = merged.size();
+					merged.resize(first + syscall_count);
+					for (size_t s = 0; s < syscall_count; s++) {
+						merged[first + s] = SyscallStatsEntry();
+						merged[first + s].provider = p;
+						merged[first + s].syscall = s;
+						merged[first + s].name = names != nullptr ? names[s] : "?";
+					}
+				}
+				SyscallStatsEntry * out = &merged[merged.size() - syscall_count];
+				for (size_t s = 0; s < syscall_count; s++) {
+					out[s].calls += row[s].calls.load(std::memory_order_relaxed);
+					out[s].errors += row[s].errors.load(std::memory_order_relaxed);
+					out[s].total_ns += row[s].total_ns.load(std::memory_order_relaxed);
+					for (size_t b = 0; b < LIBSYSCALL_STATS_BUCKETS; b++) {
+						out[s].buckets[b] += row[s].buckets[b].load(std::memory_order_relaxed);
+					}
+				}
+			}
+		}
+		merged.erase(std::remove_if(merged.begin(), merged.end(), [](const SyscallStatsEntry & e) { return e.calls == 0; }), merged.end());
+		return merged;
+	}
+
+	inline std::vector<SyscallStatsEntry> snapshot() {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::vector<SyscallStatsEntry> result = totals();
+		for (SyscallStatsEntry & e : result) {
+			for (const SyscallStatsEntry & b : baseline) {
+				if (b.provider != e.provider || b.syscall != e.syscall) continue;
+				e.calls -= b.calls;
+				e.errors -= b.errors;
+				e.total_ns -= b.total_ns;
+				for (size_t i = 0; i < LIBSYSCALL_STATS_BUCKETS; i++) e.buckets[i] -= b.buckets[i];
+			}
+		}
+		result.erase(std::remove_if(result.begin(), result.end(), [](const SyscallStatsEntry & e) { return e.calls == 0; }), result.end());
+		return result;
+	}
+
+	inline void reset() {
+		std::lock_guard<std::mutex> lock(mutex);
+		baseline = totals();
+	}
+
+	// a report in the style of 'strace -c', sorted by total time
+	inline std::string report() {
+		std::vector<SyscallStatsEntry> entries = snapshot();
+		std::sort(entries.begin(), entries.end(), [](const SyscallStatsEntry & a, const SyscallStatsEntry & b) { return a.total_ns > b.total_ns; });
+		uint64_t total_ns = 0;
+		uint64_t calls = 0;
+		uint64_t errors = 0;
+		for (const SyscallStatsEntry & e : entries) {
+			total_ns += e.total_ns;
+			calls += e.calls;
+			errors += e.errors;
+		}
+		std::string out;
+		char line[256];
+		const char * rule = "------ ----------- ----------- --------- --------- ----------- ----------------\n";
+		snprintf(line, sizeof(line), "%6s %11s %11s %9s %9s %11s %s\n", "% time", "seconds", "usecs/call", "calls", "errors", "p99 usecs", "syscall");
+		out += line;
+		out += rule;
+		for (const SyscallStatsEntry & e : entries) {
+			char errors_column[32] = "";
+			if (e.errors != 0) snprintf(errors_column, sizeof(errors_column), "%llu", (unsigned long long)e.errors);
+			snprintf(line, sizeof(line), "%6.2f %11.6f %11llu %9llu %9s %11llu %s (provider %zu)\n",
+				total_ns == 0 ? 0.0 : 100.0 * (double)e.total_ns / (double)total_ns,
+				(double)e.total_ns / 1e9,
+				(unsigned long long)(e.total_ns / e.calls / 1000),
+				(unsigned long long)e.calls,
+				errors_column,
+				(unsigned long long)(e.percentile(99) / 1000),
+				e.name,
+				e.provider
+			);
+			out += line;
+		}
+		out += rule;
+		snprintf(line, sizeof(line), "%6.2f %11.6f %11s %9llu %9llu %11s %s\n", 100.0, (double)total_ns / 1e9, "", (unsigned long long)calls, (unsigned long long)errors, "", "total");
+		out += line;
+		return out;
+	}
+};
+
+// times one call and records it when it goes out of scope, a call that throws counts as an error
+struct libsyscall__stats_scope {
+	libsyscall__stats & stats;
+	size_t provider;
+	size_t syscall;
+	bool error = false;
+	int exceptions;
+	std::chrono::steady_clock::time_point start;
+
+	inline libsyscall__stats_scope(libsyscall__stats & stats, size_t provider, size_t syscall)
+		: stats(stats), provider(provider), syscall(syscall), exceptions(std::uncaught_exceptions()), start(std::chrono::steady_clock::now()) {}
+
+	inline ~libsyscall__stats_scope() {
+		uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		stats.record(provider, syscall, ns, error || std::uncaught_exceptions() > exceptions);
+	}
+};
+
+#endif // LIBSYSCALL_SYSCALL_STATS_H
@@ -0,0 +1,358 @@
+#ifndef LIBSYSCALL_SYSCALL_TRACE_H
+#define LIBSYSCALL_SYSCALL_TRACE_H
+
+// binary traces of fd and syscall activity, see 'syscall_replay.h' to replay them
+//
+// SyscallTrace trace("app.trace", 1 << 20); // or SyscallTrace trace(1 << 20) to keep it in memory
+// SYS.trace_start(trace);
+// ...
+// SYS.trace_stop();
+//
+// every 'allocate_fd', 'deallocate_fd' and syscall becomes one fixed size record,
+//  recording claims a record with a single atomic increment and never allocates or locks
+//
+// this is included by libsyscall.h when LIBSYSCALL_TRACE is 1, but may also be included on its own to read traces
+//
+
+#include <atomic>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <tuple>
+#include <new>
+#include <stdexcept>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define LIBSYSCALL_TRACE_MMAP 1
+#else
+#define LIBSYSCALL_TRACE_MMAP 0
+#endif
+
+#define SYSCALL_TRACE_ALLOCATE 1
+#define SYSCALL_TRACE_DEALLOCATE 2
+#define SYSCALL_TRACE_CALL 3
+
+// the provider of a call on an fd that was invalid at the time
+#define SYSCALL_TRACE_NO_PROVIDER UINT32_MAX
+
+// the most syscalls a traced syscall table may have, a record holds the syscall id in 16 bits
+#define SYSCALL_TRACE_MAX_SYSCALLS 65536
+
+#define SYSCALL_TRACE_VERSION 1
+
+// one traced event, 32 bytes
+struct SyscallTraceRecord {
+	// in clock ticks, see 'SyscallTraceHeader' to convert them to nanoseconds
+	uint64_t timestamp;
+	// a small number unique to the recording thread, starting at 1
+	uint32_t thread;
+	int32_t fd;
+	// the index of the fd's provider, see 'SyscallProvider::index'
+	uint32_t provider;
+	// one of SYSCALL_TRACE_ALLOCATE, SYSCALL_TRACE_DEALLOCATE, SYSCALL_TRACE_CALL
+	uint16_t kind;
+	// the syscall id of a call, 0 otherwise
+	uint16_t syscall;
+	// the combined size of the syscall's declared arguments, 0 for anything but a call
+	uint32_t argument_bytes;
+	uint32_t reserved;
+};
+
+static_assert(sizeof(SyscallTraceRecord) == 32, "SyscallTraceRecord must be 32 bytes");
+
+// the start of a trace file, followed by 'capacity' records
+struct SyscallTraceHeader {
+	char magic[8];
+	uint16_t version;
+	uint16_t record_size;
+	// 1 if the oldest records are overwritten once the trace is full, 0 if new records are dropped
+	uint32_t wrap;
+	uint64_t capacity;
+	// the number of records ever claimed, the trace holds the last 'capacity' of them (or the first, without 'wrap')
+	uint64_t head;
+	// two readings of both the tick clock and a nanosecond clock, taken at creation and at the last flush
+	uint64_t start_ticks;
+	uint64_t start_ns;
+	uint64_t end_ticks;
+	uint64_t end_ns;
+
+	// nanoseconds per timestamp tick, estimated from the two clock readings
+	inline double ns_per_tick() const {
+		if (end_ticks <= start_ticks || end_ns <= start_ns) return 1.0;
+		return (double)(end_ns - start_ns) / (double)(end_ticks - start_ticks);
+	}
+};
+
+static_assert(sizeof(SyscallTraceHeader) == 64, "SyscallTraceHeader must be 64 bytes");
+
+// a cycle counter where there is one, nanoseconds otherwise
+inline uint64_t libsyscall__trace_ticks() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#elif defined(__aarch64__)
+	uint64_t ticks;
+	asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+	return ticks;
+#else
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+inline uint64_t libsyscall__trace_ns() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline uint32_t libsyscall__trace_thread() {
+	static std::atomic<uint32_t> threads = { 0 };
+	static thread_local uint32_t thread = threads.fetch_add(1, std::memory_order_relaxed) + 1;
+	return thread;
+}
+
+// the combined size of the declared arguments of syscall 'S'
+template <typename Tuple>
+struct libsyscall__trace_tuple_bytes;
+
+template <typename ... T>
+struct libsyscall__trace_tuple_bytes<std::tuple<T...>> : std::integral_constant<uint32_t, (0 + ... + (uint32_t)sizeof(T))> {};
+
+template <typename S>
+inline constexpr uint32_t libsyscall__trace_argument_bytes() {
+	return libsyscall__trace_tuple_bytes<typename S::argument_tuple>::value;
+}
+
+// a fixed size buffer of trace records, either in memory or backed by a memory mapped file
+//
+// the capacity is rounded up to a power of two
+//
+// recording is thread safe, reading ('records', 'save') must not overlap with recording, see 'SYSCALL_BASE::trace_stop'
+//
+struct SyscallTrace {
+	inline SyscallTrace(size_t capacity, bool wrap = true) {
+		init(capacity, wrap);
+		memory = ::operator new(bytes());
+		start();
+	}
+
+	// the trace is written to 'path' as it is recorded, the file is created or truncated
+	//
+	// the pages are written back by the os, 'flush' (and the destructor) also update the header
+	//
+	inline SyscallTrace(const std::string & path, size_t capacity, bool wrap = true) {
+		init(capacity, wrap);
+#if LIBSYSCALL_TRACE_MMAP
+		file = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (file == -1) {
+			std::string msg = "SyscallTrace ERROR: failed to open '" + path + "'";
+			throw new std::runtime_error(msg.c_str());
+		}
+		if (::ftruncate(file, (off_t)bytes()) != 0) {
+			::close(file);
+			std::string msg = "SyscallTrace ERROR: failed to resize '" + path + "'";
+			throw new std::runtime_error(msg.c_str());
+		}
+		memory = ::mmap(nullptr, bytes(), PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+		if (memory == MAP_FAILED) {
+			::close(file);
+			std::string msg = "SyscallTrace ERROR: failed to map '" + path + "'";
+			throw new std::runtime_error(msg.c_str());
+		}
+		start();
+#else
+		(void)path;
+		throw new std::runtime_error("SyscallTrace ERROR: memory mapped traces are not supported on this platform, use an in memory trace and 'save'");
+#endif
+	}
+
+	SyscallTrace(const SyscallTrace &) = delete;
+	SyscallTrace & operator=(const SyscallTrace &) = delete;
+
+	inline ~SyscallTrace() {
+#if LIBSYSCALL_TRACE_MMAP
+		if (file != -1) {
+			flush();
+			::munmap(memory, bytes());
+			::close(file);
+			return;
+		}
+#endif
+		::operator delete(memory);
+	}
+
+	inline void record(uint16_t kind, int fd, uint32_t provider, uint16_t syscall, uint32_t argument_bytes) {
+		uint64_t ticket = head.fetch_add(1, std::memory_order_relaxed);
+		if (!wrap && ticket > mask) return;
+		SyscallTraceRecord & r = records_begin()[ticket & mask];
+		r.timestamp = libsyscall__trace_ticks();
+		r.thread = libsyscall__trace_thread();
+		r.fd = fd;
+		r.provider = provider;
+		r.kind = kind;
+		r.syscall = syscall;
+		r.argument_bytes = argument_bytes;
+		r.reserved = 0;
+	}
+
+	inline size_t capacity() const { return mask + 1; }
+
+	// the number of records held
+	inline size_t size() const {
+		uint64_t h = head.load(std::memory_order_acquire);
+		return h < capacity() ? (size_t)h : capacity();
+	}
+
+	// the number of records that were overwritten or dropped
+	inline uint64_t lost() const {
+		uint64_t h = head.load(std::memory_order_acquire);
+		return h < capacity() ? 0 : h - capacity();
+	}
+
+	inline void clear() {
+		head.store(0, std::memory_order_relaxed);
+		start();
+	}
+
+	// the records held, oldest first
+	inline std::vector<SyscallTraceRecord> records() {
+		flush();
+		return ordered(header(), records_begin());
+	}
+
+	// updates the header, and writes a memory mapped trace back to its file
+	inline void flush() {
+		SyscallTraceHeader & h = header();
+		h.head = head.load(std::memory_order_acquire);
+		h.end_ticks = libsyscall__trace_ticks();
+		h.end_ns = libsyscall__trace_ns();
+#if LIBSYSCALL_TRACE_MMAP
+		if (file != -1) ::msync(memory, bytes(), MS_SYNC);
+#endif
+	}
+
+	// writes the records held to 'path', oldest first, in the same format as a memory mapped trace
+	inline void save(const std::string & path) {
+		std::vector<SyscallTraceRecord> list = records();
+		SyscallTraceHeader h = header();
+		h.wrap = 0;
+		h.capacity = list.size();
+		h.head = list.size();
+		FILE * f = fopen(path.c_str(), "wb");
+		if (f == nullptr) {
+			std::string msg = "SyscallTrace ERROR: failed to open '" + path + "'";
+			throw new std::runtime_error(msg.c_str());
+		}
+		bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+		if (ok && !list.empty()) ok = fwrite(list.data(), sizeof(SyscallTraceRecord), list.size(), f) == list.size();
+		if (fclose(f) != 0) ok = false;
+		if (!ok) {
+			std::string msg = "SyscallTrace ERROR: failed to write '" + path + "'";
+			throw new std::runtime_error(msg.c_str());
+		}
+	}
+
+	inline const SyscallTraceHeader & info() {
+		flush();
+		return header();
+	}
+
+	// the records of a trace file, oldest first
+	static inline std::vector<SyscallTraceRecord> load(const std::string & path, SyscallTraceHeader * header_out = nullptr) {
+		FILE * f = fopen(path.c_str(), "rb");
+		if (f == nullptr) {
+			std::string msg = "SyscallTrace ERROR: failed to open '" + path + "'";
+			throw new std::runtime_error(msg.c_str());
+		}
+		SyscallTraceHeader h;
+		if (fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, "LSCTRACE", 8) != 0 || h.version != SYSCALL_TRACE_VERSION || h.record_size != sizeof(SyscallTraceRecord)) {
+			fclose(f);
+			std::string msg = "SyscallTrace ERROR: '" + path + "' is not a trace";
+			throw new std::runtime_error(msg.c_str());
+		}
+		std::vector<SyscallTraceRecord> stored(h.capacity);
+		size_t n = stored.empty() ? 0 : fread(stored.data(), sizeof(SyscallTraceRecord), stored.size(), f);
+		fclose(f);
+		if (n != stored.size()) {
+			std::string msg = "SyscallTrace ERROR: '" + path + "' is truncated";
+			throw new std::runtime_error(msg.c_str());
+		}
+		if (header_out != nullptr) *header_out = h;
+		return ordered(h, stored.data());
+	}
+
+private:
+	void * memory = nullptr;
+	uint64_t mask = 0;
+	bool wrap = true;
+#if LIBSYSCALL_TRACE_MMAP
+	int file = -1;
+#endif
+	alignas(64) std::atomic<uint64_t> head = { 0 };
+
+	inline void init(size_t capacity, bool wrap_) {
+		size_t n = 1;
+		while (n < capacity) n <<= 1;
+		mask = n - 1;
+		wrap = wrap_;
+	}
+
+	inline size_t bytes() const { return sizeof(SyscallTraceHeader) + sizeof(SyscallTraceRecord) * capacity(); }
+
+	inline SyscallTraceHeader & header() { return *static_cast<SyscallTraceHeader*>(memory); }
+
+	inline SyscallTraceRecord * records_begin() { return reinterpret_cast<SyscallTraceRecord*>(static_cast<char*>(memory) + sizeof(SyscallTraceHeader)); }
+
+	inline void start() {
+		SyscallTraceHeader & h = header();
+		memset(&h, 0, sizeof(h));
+		memcpy(h.magic, "LSCTRACE", 8);
+		h.version = SYSCALL_TRACE_VERSION;
+		h.record_size = sizeof(SyscallTraceRecord);
+		h.wrap = wrap ? 1 : 0;
+		h.capacity = capacity();
+		h.start_ticks = libsyscall__trace_ticks();
+		h.start_ns = libsyscall__trace_ns();
+		h.end_ticks = h.start_ticks;
+		h.end_ns = h.start_ns;
+	}
+
+	static inline std::vector<SyscallTraceRecord> ordered(const SyscallTraceHeader & h, const SyscallTraceRecord * stored) {
+		std::vector<SyscallTraceRecord> list;
+		if (h.capacity == 0) return list;
+		uint64_t count = h.head < h.capacity ? h.head : h.capacity;
+		uint64_t first = h.wrap && h.head > h.capacity ? h.head - h.capacity : 0;
+		list.reserve((size_t)count);
+		for (uint64_t i = 0; i < count; i++) {
+			list.push_back(stored[(first + i) % h.capacity]);
+		}
+		return list;
+	}
+};
+
+// the trace a SYSCALL_BASE records into, see 'SYSCALL_BASE::trace_start'
+struct libsyscall__tracer {
+	std::atomic<SyscallTrace*> target = { nullptr };
+	// per syscall id, see 'libsyscall__trace_argument_bytes'
+	const uint32_t * argument_bytes = nullptr;
+
+	inline void record(uint16_t kind, int fd, size_t provider, size_t id) {
+		SyscallTrace * trace = target.load(std::memory_order_relaxed);
+		if (trace == nullptr) return;
+		uint32_t bytes = kind == SYSCALL_TRACE_CALL && argument_bytes != nullptr ? argument_bytes[id] : 0;
+		trace->record(kind, fd, (uint32_t)provider, (uint16_t)id, bytes);
+	}
+};
+
+#endif // LIBSYSCALL_SYSCALL_TRACE_H
@@ -0,0 +1,100 @@
+// compares KNHeap against std::priority_queue over random mixes of single and batch operations
+//
+// every configuration runs a fixed set of seeds, a mismatch prints the configuration, seed and round and fails the test
+//
+// the deep configuration is small enough that its merge trees and level merges are all exercised,
+//  its element count is kept below its capacity, which KNHeap does not check
+
+#include <libsyscall/knheap.h>
+
+#include <queue>
+#include <vector>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+
+typedef std::priority_queue<int, std::vector<int>, std::greater<int>> Reference;
+
+static void * value_of(int key) {
+	return (void*)(intptr_t)key;
+}
+
+// elements inserted by the keys-only 'insertBatch' have nullptr values
+static bool value_matches(void * value, int key) {
+	return value == nullptr || value == value_of(key);
+}
+
+template <typename Heap>
+static bool run(const char * name, unsigned seed, int rounds, int max_batch, size_t capacity) {
+	Heap * heap = new Heap(INT_MAX, INT_MIN);
+	Reference reference;
+	std::mt19937 rng(seed);
+	std::vector<int> keys;
+	std::vector<void*> values;
+	bool ok = true;
+	for (int round = 0; round < rounds && ok; round++) {
+		int op = (int)(rng() % 4);
+		// inserts turn into deletes near the capacity
+		if (reference.size() + (size_t)max_batch > capacity && op < 2) op += 2;
+		int n = (int)(rng() % (unsigned)max_batch);
+		if (op == 0) {
+			for (int i = 0; i < n; i++) {
+				int key = (int)(rng() % 1000000);
+				heap->insert(key, value_of(key));
+				reference.push(key);
+			}
+		}
+		else if (op == 1) {
+			// sorted batches take the path that moves a full batch straight into the merge trees
+			bool sorted = rng() % 2 == 0;
+			int base = (int)(rng() % 1000000);
+			keys.resize(n);
+			values.resize(n);
+			for (int i = 0; i < n; i++) {
+				keys[i] = sorted ? base + i : (int)(rng() % 1000000);
+				values[i] = value_of(keys[i]);
+				reference.push(keys[i]);
+			}
+			if (rng() % 2 == 0) heap->insertBatch(keys.data(), values.data(), n);
+			else heap->insertBatch(keys.data(), n);
+		}
+		else if (op == 2) {
+			for (int i = 0; i < n && !reference.empty(); i++) {
+				int key;
+				void * value;
+				heap->deleteMin(&key, &value);
+				if (key != reference.top() || !value_matches(value, key)) ok = false;
+				reference.pop();
+			}
+		}
+		else {
+			keys.resize(n);
+			values.assign(n, nullptr);
+			bool with_values = rng() % 2 == 0;
+			int got = with_values ? heap->deleteMinN(keys.data(), values.data(), n) : heap->deleteMinN(keys.data(), n);
+			if (got != (int)std::min<size_t>((size_t)n, reference.size())) ok = false;
+			for (int i = 0; i < got && ok; i++) {
+				if (keys[i] != reference.top() || (with_values && !value_matches(values[i], keys[i]))) ok = false;
+				reference.pop();
+			}
+		}
+		if (heap->getSize() != (int)reference.size()) ok = false;
+		if (!ok) printf("%s: seed %u round %d: mismatch\n", name, seed, round);
+	}
+	delete heap;
+	return ok;
+}
+
+int main() {
+	bool ok = true;
+	for (unsigned seed = 1; seed <= 8; seed++) {
+		ok = run<KNHeapL1<int, void*>>("KNHeapL1", seed, 300, 1500, (size_t)1 << 30) && ok;
+		ok = run<KNHeapL2<int, void*>>("KNHeapL2", seed, 300, 3000, (size_t)1 << 30) && ok;
+		ok = run<KNHeap<int, void*, 4, 8, 8, 4>>("KNHeap<4, 8, 8, 4>", seed, 150, 300, 3500) && ok;
+	}
+	printf("%s\n", ok ? "ok" : "FAILED");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+// runs calls on a SyscallSharedSegment across forked processes
+//
+// every case forks a child that attaches to the segment, shares an fd and reports its global fd through a pipe,
+//  the parent then calls it, a child exits with 0 unless one of its own checks failed
+//
+// the segment has room for two processes, so every child attaches to the slot the child before it left behind,
+//  whether that one detached or died and had to be reaped
+
+#include <libsyscall/syscall_shared.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include <thread>
+#include <cerrno>
+#include <cstdio>
+
+struct SYS_ADD : Syscall<SYS_ADD, int(int)> {};
+struct SYS_EXIT : Syscall<SYS_EXIT, int()> {};
+
+struct TEST_SYSCALLS : SYSCALLS<SYS_ADD, SYS_EXIT> {};
+
+static int add(int, void * data, int value) {
+	return *static_cast<int*>(data) * 1000 + value;
+}
+
+// the owner dies while it runs the call
+static int exit_now(int, void*) {
+	_exit(0);
+}
+
+static bool check(bool condition, const char * name, const char * what) {
+	if (!condition) printf("%s: %s\n", name, what);
+	return condition;
+}
+
+static bool send_int(int fd, int value) {
+	return write(fd, &value, sizeof(value)) == (ssize_t)sizeof(value);
+}
+
+static bool receive_int(int fd, int * value) {
+	return read(fd, value, sizeof(*value)) == (ssize_t)sizeof(*value);
+}
+
+static bool exited_cleanly(pid_t child) {
+	int status;
+	return waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// a child that shares one fd whose resource is 'value', serves it if 'serve' is set, and otherwise dies without detaching
+//
+// a serving child detaches once the parent writes to 'done'
+static pid_t fork_owner(SyscallSharedSegment & segment, int value, bool serve, int report, int done) {
+	pid_t child = fork();
+	if (child != 0) return child;
+	static int resource;
+	resource = value;
+	TEST_SYSCALLS sys;
+	SYSCALL_BASE::SyscallProvider & provider = sys.create_provider_entry();
+	sys.register_syscall<SYS_ADD>(provider, &add);
+	sys.register_syscall<SYS_EXIT>(provider, &exit_now);
+	int fd = sys.allocate_fd(provider, &resource, nullptr);
+	if (!serve) {
+		// never destroyed, the slot stays taken until it is reaped
+		SyscallShared<TEST_SYSCALLS> * shared = new SyscallShared<TEST_SYSCALLS>(sys, segment);
+		if (!send_int(report, shared->share(fd))) _exit(1);
+		// long enough for the parent to queue a call
+		usleep(200000);
+		_exit(0);
+	}
+	bool ok;
+	{
+		SyscallShared<TEST_SYSCALLS> shared(sys, segment);
+		std::thread server([&] { shared.serve(); });
+		ok = send_int(report, shared.share(fd));
+		int unused;
+		ok = receive_int(done, &unused) && ok;
+		shared.stop();
+		server.join();
+	}
+	_exit(ok ? 0 : 1);
+}
+
+static bool forwarded(SyscallSharedSegment & segment, SyscallShared<TEST_SYSCALLS> & shared, int report[2], int done[2]) {
+	const char * name = "forwarded";
+	pid_t child = fork_owner(segment, 9, true, report[1], done[0]);
+	int global;
+	bool ok = check(receive_int(report[0], &global), name, "no global fd reported");
+	if (ok) {
+		for (int i = 0; i < 100 && ok; i++) {
+			SyscallResult<int> r = shared.try_call<SYS_ADD>(global, i);
+			ok = check(r.ok() && *r == 9000 + i, name, "wrong result");
+		}
+	}
+	ok = check(send_int(done[1], 1), name, "could not release the owner") && ok;
+	ok = check(exited_cleanly(child), name, "owner failed") && ok;
+	// the owner detached, which unshared its fd
+	ok = check(shared.try_call<SYS_ADD>(global, 1).error() == EBADF, name, "fd still shared after detaching") && ok;
+	return ok;
+}
+
+static bool abandoned(SyscallSharedSegment & segment, SyscallShared<TEST_SYSCALLS> & shared, int report[2], int done[2]) {
+	const char * name = "abandoned";
+	pid_t child = fork_owner(segment, 5, true, report[1], done[0]);
+	int global;
+	bool ok = check(receive_int(report[0], &global), name, "no global fd reported");
+	if (ok) {
+		// the caller wakes up from its futex wait, finds the owner gone, reaps it and gives up on its reply slot
+		ok = check(shared.try_call<SYS_EXIT>(global).error() == EPIPE, name, "call on an owner that died running it did not fail with EPIPE");
+		ok = check(shared.try_call<SYS_ADD>(global, 1).error() == EBADF, name, "fd still shared after reaping") && ok;
+	}
+	ok = check(exited_cleanly(child), name, "owner failed") && ok;
+	return ok;
+}
+
+static bool reaped(SyscallSharedSegment & segment, SyscallShared<TEST_SYSCALLS> & shared, int report[2], int done[2]) {
+	const char * name = "reaped";
+	pid_t child = fork_owner(segment, 3, false, report[1], done[0]);
+	int global;
+	bool ok = check(receive_int(report[0], &global), name, "no global fd reported");
+	if (ok) {
+		// queued in a ring nobody serves, swept when the dead owner is reaped
+		ok = check(shared.try_call<SYS_ADD>(global, 1).error() == EPIPE, name, "queued call on a dead owner did not fail with EPIPE");
+		ok = check(shared.try_call<SYS_ADD>(global, 1).error() == EBADF, name, "fd still shared after reaping") && ok;
+	}
+	ok = check(exited_cleanly(child), name, "owner failed") && ok;
+	return ok;
+}
+
+int main() {
+	SyscallSharedOptions options;
+	options.fds = 64;
+	options.processes = 2;
+	options.ring_entries = 8;
+	options.replies = 8;
+	SyscallSharedSegment segment(options);
+	TEST_SYSCALLS sys;
+	SyscallShared<TEST_SYSCALLS> shared(sys, segment);
+	int report[2];
+	int done[2];
+	if (pipe(report) != 0 || pipe(done) != 0) {
+		printf("pipe failed\n");
+		return 1;
+	}
+	bool ok = true;
+	ok = forwarded(segment, shared, report, done) && ok;
+	ok = abandoned(segment, shared, report, done) && ok;
+	ok = reaped(segment, shared, report, done) && ok;
+	// every slot was left behind by a child, the last one reaped, so attaching again must succeed
+	ok = forwarded(segment, shared, report, done) && ok;
+	printf("%s\n", ok ? "ok" : "FAILED");
+	return ok ? 0 : 1;
+}
@@ -20,6 +20,16 @@ typedef struct wl_syscalls__fd_allocator {
 
 typedef void (*WL_SYSCALLS_FD_ALLOCATOR_CALLBACK___DESTROY_DATA)(int fd, void** data, bool in_destructor);
 
+// the inline part of an fd slot
+//
+// 'data' is the value passed to 'allocate_fd'
+// 'table' is an optional pointer stored next to 'data', libsyscall stores the provider (which holds its syscall table) here
+//   so that a single slot lookup yields both without chasing any further pointers
+typedef struct wl_syscalls__fd_allocator__slot {
+    void* data;
+    void* table;
+} wl_syscalls__fd_allocator__slot;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -29,10 +39,15 @@ extern "C" {
     int                         wl_syscalls__fd_allocator__allocate_fd(
         wl_syscalls__fd_allocator* wl_syscalls__fd_allocator, void* data, WL_SYSCALLS_FD_ALLOCATOR_CALLBACK___DESTROY_DATA callback
     );
+    int                         wl_syscalls__fd_allocator__allocate_fd_with_table(
+        wl_syscalls__fd_allocator* wl_syscalls__fd_allocator, void* data, void* table, WL_SYSCALLS_FD_ALLOCATOR_CALLBACK___DESTROY_DATA callback
+    );
     size_t                      wl_syscalls__fd_allocator__size(wl_syscalls__fd_allocator* wl_syscalls__fd_allocator);
     size_t                      wl_syscalls__fd_allocator__capacity(wl_syscalls__fd_allocator* wl_syscalls__fd_allocator);
     bool                        wl_syscalls__fd_allocator__fd_is_valid(wl_syscalls__fd_allocator* wl_syscalls__fd_allocator, int fd);
     void* wl_syscalls__fd_allocator__get_value_from_fd(wl_syscalls__fd_allocator* wl_syscalls__fd_allocator, int fd);
+    // returns NULL if 'fd' is invalid, this combines 'fd_is_valid' and 'get_value_from_fd' into a single lookup
+    wl_syscalls__fd_allocator__slot* wl_syscalls__fd_allocator__get_slot_from_fd(wl_syscalls__fd_allocator* wl_syscalls__fd_allocator, int fd);
     void                        wl_syscalls__fd_allocator__deallocate_fd(wl_syscalls__fd_allocator* wl_syscalls__fd_allocator, int fd);
 
     void* KNHeap__create(void);
@@ -41,15 +56,23 @@ extern "C" {
     void  KNHeap__getMin(void* instance, wl_syscalls__fd_allocator__size_t* key, void** value);
     void  KNHeap__deleteMin(void* instance, wl_syscalls__fd_allocator__size_t* key, void** value);
     void  KNHeap__insert(void* instance, wl_syscalls__fd_allocator__size_t key, void* value);
+    // inserts 'n' keys with NULL values
+    void  KNHeap__insertBatch(void* instance, const wl_syscalls__fd_allocator__size_t* keys, int n);
+    // deletes up to 'n' of the smallest keys in increasing order, and returns how many were deleted
+    int   KNHeap__deleteMinN(void* instance, wl_syscalls__fd_allocator__size_t* keys, int n);
 
     void* ShrinkingVectorIndexAllocator__create(void);
     void   ShrinkingVectorIndexAllocator__destroy(void* instance);
     size_t ShrinkingVectorIndexAllocator__size(void* instance);
     size_t ShrinkingVectorIndexAllocator__capacity(void* instance);
+    size_t ShrinkingVectorIndexAllocator__limit(void* instance);
     size_t ShrinkingVectorIndexAllocator__add(void* instance, void* value, WL_SYSCALLS_FD_ALLOCATOR_CALLBACK___DESTROY_DATA callback);
+    size_t ShrinkingVectorIndexAllocator__add_with_table(void* instance, void* value, void* table, WL_SYSCALLS_FD_ALLOCATOR_CALLBACK___DESTROY_DATA callback);
     size_t ShrinkingVectorIndexAllocator__reuse(void* instance, size_t index, void* value, WL_SYSCALLS_FD_ALLOCATOR_CALLBACK___DESTROY_DATA callback);
+    size_t ShrinkingVectorIndexAllocator__reuse_with_table(void* instance, size_t index, void* value, void* table, WL_SYSCALLS_FD_ALLOCATOR_CALLBACK___DESTROY_DATA callback);
     bool   ShrinkingVectorIndexAllocator__index_is_valid(void* instance, size_t index);
     void* ShrinkingVectorIndexAllocator__data(void* instance, size_t index);
+    wl_syscalls__fd_allocator__slot* ShrinkingVectorIndexAllocator__slot(void* instance, size_t index);
     bool   ShrinkingVectorIndexAllocator__remove(void* instance, int index);
 
 #ifdef __cplusplus